@@ -0,0 +1,177 @@
+"""Generates synthetic count matrices for the smallcount benchmarks.
+
+Counts are drawn from a negative binomial distribution with gene-specific means
+and cell-specific size factors, mimicking droplet-based single-cell data. The
+overall mean is chosen so that the expected fraction of non-zero entries
+matches --density.
+
+Output layout (in --outdir):
+    mtx/           matrix.mtx, barcodes.tsv, features.tsv (Cell Ranger v3)
+    mtx_gz/        The same files, gzipped
+    matrix.csv     Dense .csv file (only written if --csv is set)
+    matrix.h5      .h5 file (Cell Ranger v3 format)
+    metadata.json  Parameters used to generate the data, plus the number of
+                   non-zero entries
+
+Example:
+    python3 inst/benchmarks/generate_benchmark_data.py \\
+        --genes 30000 --cells 100000 --density 0.05 --outdir bench_data
+"""
+
+import argparse
+import gzip
+import json
+import os
+import shutil
+
+import h5py
+import numpy as np
+from scipy.sparse import csc_matrix, hstack
+
+# Number of cells generated at a time, bounding the size of the dense blocks.
+CHUNK_SIZE = 1000
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--genes", type=int, default=2000)
+    parser.add_argument("--cells", type=int, default=10000)
+    parser.add_argument("--density", type=float, default=0.05,
+                        help="Expected fraction of non-zero entries")
+    parser.add_argument("--dispersion", type=float, default=0.5,
+                        help="Negative binomial dispersion (1 / size)")
+    parser.add_argument("--mito-genes", type=int, default=13,
+                        help="Number of genes named with the MT- prefix")
+    parser.add_argument("--seed", type=int, default=20240508)
+    parser.add_argument("--csv", action="store_true",
+                        help="Also write a dense .csv file (small scales only)")
+    parser.add_argument("--outdir", default="bench_data")
+    return parser.parse_args()
+
+
+def expected_density(mu, size):
+    """Mean probability that a negative binomial draw is non-zero."""
+    return np.mean(1 - (1 + mu / size) ** -size)
+
+
+def calibrate_scale(gene_means, size_factors, size, density):
+    """Finds the scale of the means giving the target density by bisection."""
+    mu = np.outer(gene_means, size_factors[:CHUNK_SIZE])
+    lo, hi = 1e-8, 1e8
+    for _ in range(100):
+        mid = np.sqrt(lo * hi)
+        if expected_density(mid * mu, size) < density:
+            lo = mid
+        else:
+            hi = mid
+    return np.sqrt(lo * hi)
+
+
+def generate_matrix(args, rng):
+    size = 1 / args.dispersion
+    gene_means = rng.lognormal(mean=0, sigma=1.5, size=args.genes)
+    size_factors = rng.lognormal(mean=0, sigma=0.5, size=args.cells)
+    scale = calibrate_scale(gene_means, size_factors, size, args.density)
+
+    chunks = []
+    for start in range(0, args.cells, CHUNK_SIZE):
+        end = min(start + CHUNK_SIZE, args.cells)
+        mu = scale * np.outer(gene_means, size_factors[start:end])
+        # NB(size, mu) as a gamma-Poisson mixture.
+        counts = rng.poisson(rng.gamma(shape=size, scale=mu / size))
+        chunks.append(csc_matrix(counts.astype(np.int32)))
+    return hstack(chunks, format="csc")
+
+
+def feature_names(args):
+    ids = [f"ENSG{i:011d}" for i in range(args.genes)]
+    symbols = [f"GENE{i}" for i in range(args.genes)]
+    for i in range(min(args.mito_genes, args.genes)):
+        symbols[i] = f"MT-GENE{i}"
+    return ids, symbols
+
+
+def barcode_names(args):
+    return [f"CELL{i:08d}-1" for i in range(args.cells)]
+
+
+def write_mtx(mat, ids, symbols, barcodes, outdir):
+    os.makedirs(outdir, exist_ok=True)
+    mat.sort_indices()
+    # Entries are written column by column, as Cell Ranger does, in chunks to
+    # bound the size of the formatted text.
+    with open(os.path.join(outdir, "matrix.mtx"), "w") as f:
+        f.write("%%MatrixMarket matrix coordinate integer general\n")
+        f.write(f"{mat.shape[0]} {mat.shape[1]} {mat.nnz}\n")
+        for start in range(0, mat.shape[1], CHUNK_SIZE):
+            end = min(start + CHUNK_SIZE, mat.shape[1])
+            p0, p1 = mat.indptr[start], mat.indptr[end]
+            cols = np.repeat(np.arange(start, end), np.diff(
+                mat.indptr[start:end + 1]))
+            entries = np.column_stack(
+                (mat.indices[p0:p1] + 1, cols + 1, mat.data[p0:p1]))
+            np.savetxt(f, entries, fmt="%d")
+    with open(os.path.join(outdir, "features.tsv"), "w") as f:
+        for gene_id, symbol in zip(ids, symbols):
+            f.write(f"{gene_id}\t{symbol}\tGene Expression\n")
+    with open(os.path.join(outdir, "barcodes.tsv"), "w") as f:
+        f.write("\n".join(barcodes) + "\n")
+
+
+def write_mtx_gz(mtx_dir, outdir):
+    os.makedirs(outdir, exist_ok=True)
+    for name in ["matrix.mtx", "features.tsv", "barcodes.tsv"]:
+        with open(os.path.join(mtx_dir, name), "rb") as src, \
+                gzip.open(os.path.join(outdir, name + ".gz"), "wb") as dst:
+            shutil.copyfileobj(src, dst)
+
+
+def write_csv(mat, ids, barcodes, filename):
+    csr = mat.tocsr()
+    with open(filename, "w") as f:
+        f.write("," + ",".join(barcodes) + "\n")
+        for i, gene_id in enumerate(ids):
+            row = csr.getrow(i).toarray().ravel()
+            f.write(gene_id + "," + ",".join(map(str, row)) + "\n")
+
+
+def write_h5(mat, ids, symbols, barcodes, filename):
+    with h5py.File(filename, "w") as hf:
+        hf.create_dataset("matrix/data", dtype=np.uint32, data=mat.data)
+        hf.create_dataset("matrix/indices", dtype=np.uint32, data=mat.indices)
+        hf.create_dataset("matrix/indptr", dtype=np.uint64, data=mat.indptr)
+        hf.create_dataset("matrix/shape", dtype=np.uint64, data=mat.shape)
+        to_bytes = lambda names: np.array([n.encode("utf-8") for n in names])
+        hf.create_dataset("matrix/barcodes", data=to_bytes(barcodes))
+        hf.create_dataset("matrix/features/id", data=to_bytes(ids))
+        hf.create_dataset("matrix/features/name", data=to_bytes(symbols))
+        hf.create_dataset("matrix/features/feature_type",
+                          data=to_bytes(["Gene Expression"] * len(ids)))
+
+
+def main():
+    args = parse_args()
+    rng = np.random.default_rng(args.seed)
+    os.makedirs(args.outdir, exist_ok=True)
+
+    mat = generate_matrix(args, rng)
+    ids, symbols = feature_names(args)
+    barcodes = barcode_names(args)
+
+    mtx_dir = os.path.join(args.outdir, "mtx")
+    write_mtx(mat, ids, symbols, barcodes, mtx_dir)
+    write_mtx_gz(mtx_dir, os.path.join(args.outdir, "mtx_gz"))
+    write_h5(mat, ids, symbols, barcodes,
+             os.path.join(args.outdir, "matrix.h5"))
+    if args.csv:
+        write_csv(mat, ids, barcodes, os.path.join(args.outdir, "matrix.csv"))
+
+    metadata = vars(args).copy()
+    metadata["nnz"] = int(mat.nnz)
+    metadata["observed_density"] = mat.nnz / (args.genes * args.cells)
+    with open(os.path.join(args.outdir, "metadata.json"), "w") as f:
+        json.dump(metadata, f, indent=2)
+
+
+if __name__ == "__main__":
+    main()
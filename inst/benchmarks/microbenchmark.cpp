@@ -0,0 +1,690 @@
+// Microbenchmark of the Rcpp-free core of smallcount on synthetic data.
+//
+// Generates a negative binomial count matrix, writes it as .mtx, .csv and .h5
+// files in a temporary directory, and times the file readers and writers and
+// the numeric kernels. Results are written to stdout as .csv. The heap memory
+// of the residuals stored as double and as float is written to stderr. With
+// --profile=1, the stages of one read of each file are also written to stderr,
+// with allocation counts and exact peak heap usage from the replaced global
+// operator new/delete.
+//
+// Build (from the package root):
+//   cmake -S . -B build && cmake --build build
+// Usage:
+//   build/smallcount_microbenchmark [--genes=2000] [--cells=5000]
+//       [--density=0.05] [--reps=5] [--k=50] [--seed=1] [--filter=substr]
+//       [--dir=/tmp/smallcount_microbenchmark] [--profile=0]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "csc_matrix.h"
+#include "csr_index.h"
+#include "error.h"
+#include "file_reader.h"
+#include "file_writer.h"
+#include "gene_summaries.h"
+#include "gram.h"
+#include "group_deviance.h"
+#include "hdf5.h"
+#include "knn_graph.h"
+#include "matrix_names.h"
+#include "native_matrix.h"
+#include "profiler.h"
+#include "residual_matrix.h"
+#include "residuals.h"
+#include "sparse_columns.h"
+#include "sparse_matrix.h"
+#include "sparse_sums.h"
+#include "tenx_file_params.h"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+
+namespace {
+
+// The allocator is called from functions that are never inlined into the
+// replaced operators below, so that GCC does not see free() called on the
+// result of operator new (-Wmismatched-new-delete).
+[[gnu::noinline]] void *allocate(size_t size) {
+    void *ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr != nullptr) {
+        smallcount::internal::noteAllocation(malloc_usable_size(ptr));
+    }
+    return ptr;
+}
+
+[[gnu::noinline]] void deallocate(void *ptr) {
+    if (ptr != nullptr) {
+        smallcount::internal::noteDeallocation(malloc_usable_size(ptr));
+        std::free(ptr);
+    }
+}
+
+}  // namespace
+
+// Reports every heap allocation to the profiler. The array and sized forms
+// forward to these by default.
+void *operator new(size_t size) {
+    void *ptr = allocate(size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept { deallocate(ptr); }
+
+void operator delete(void *ptr, size_t) noexcept { deallocate(ptr); }
+#endif
+
+namespace {
+
+using smallcount::CscMatrix;
+using smallcount::MatrixMetadata;
+using smallcount::ResidualParams;
+using smallcount::ResidualType;
+using smallcount::Svt;
+using smallcount::SvtEntry;
+using smallcount::SvtSparseMatrix;
+using smallcount::kSvtRowInd;
+using smallcount::kSvtValInd;
+
+struct Options {
+    int genes = 2000;
+    int cells = 5000;
+    double density = 0.05;
+    double dispersion = 0.5;
+    int reps = 5;
+    int k = 50;
+    unsigned int seed = 1;
+    std::string filter;
+    bool profile = false;
+    std::string dir = (std::filesystem::temp_directory_path() /
+                       "smallcount_microbenchmark")
+                          .string();
+};
+
+Options parseOptions(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == std::string::npos) {
+            smallcount::fail("Invalid argument: %s", arg);
+        }
+        const std::string key = arg.substr(2, eq - 2);
+        const std::string value = arg.substr(eq + 1);
+        if (key == "genes") {
+            options.genes = std::stoi(value);
+        } else if (key == "cells") {
+            options.cells = std::stoi(value);
+        } else if (key == "density") {
+            options.density = std::stod(value);
+        } else if (key == "dispersion") {
+            options.dispersion = std::stod(value);
+        } else if (key == "reps") {
+            options.reps = std::stoi(value);
+        } else if (key == "k") {
+            options.k = std::stoi(value);
+        } else if (key == "seed") {
+            options.seed = std::stoul(value);
+        } else if (key == "filter") {
+            options.filter = value;
+        } else if (key == "dir") {
+            options.dir = value;
+        } else if (key == "profile") {
+            options.profile = std::stoi(value) != 0;
+        } else {
+            smallcount::fail("Unknown option: %s", key);
+        }
+    }
+    return options;
+}
+
+// Mean probability that a negative binomial draw with the given means is
+// non-zero.
+double expectedDensity(const std::vector<double> &mu, double scale,
+                       double size) {
+    double sum = 0;
+    for (double m : mu) {
+        sum += 1 - std::pow(1 + scale * m / size, -size);
+    }
+    return sum / mu.size();
+}
+
+// Generates negative binomial counts with gene-specific means and cell size
+// factors, scaled so that the expected density matches `options.density`.
+SvtSparseMatrix generateMatrix(const Options &options) {
+    std::mt19937_64 rng(options.seed);
+    std::lognormal_distribution<double> gene_dist(0, 1.5);
+    std::lognormal_distribution<double> cell_dist(0, 0.5);
+    std::vector<double> gene_means(options.genes);
+    std::vector<double> size_factors(options.cells);
+    for (double &m : gene_means) m = gene_dist(rng);
+    for (double &s : size_factors) s = cell_dist(rng);
+
+    // Calibrate the scale of the means by bisection on a subsample of cells.
+    const double size = 1 / options.dispersion;
+    std::vector<double> sample_mu;
+    for (int j = 0; j < std::min(options.cells, 100); j++) {
+        for (double m : gene_means) sample_mu.push_back(m * size_factors[j]);
+    }
+    double lo = 1e-8, hi = 1e8;
+    for (int iter = 0; iter < 100; iter++) {
+        const double mid = std::sqrt(lo * hi);
+        if (expectedDensity(sample_mu, mid, size) < options.density) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    const double scale = std::sqrt(lo * hi);
+
+    Svt svt(options.cells, SvtEntry(2));
+    size_t nval = 0;
+    for (int j = 0; j < options.cells; j++) {
+        for (int i = 0; i < options.genes; i++) {
+            const double mu = scale * gene_means[i] * size_factors[j];
+            // NB(size, mu) as a gamma-Poisson mixture.
+            const double lambda =
+                std::gamma_distribution<double>(size, mu / size)(rng);
+            if (lambda <= 0) {
+                continue;
+            }
+            const int count = std::poisson_distribution<int>(lambda)(rng);
+            if (count != 0) {
+                svt[j][kSvtRowInd].push_back(i);
+                svt[j][kSvtValInd].push_back(count);
+                nval++;
+            }
+        }
+    }
+
+    MatrixMetadata metadata{
+        .nrow = options.genes, .ncol = options.cells, .nval = nval};
+    for (int i = 0; i < options.genes; i++) {
+        metadata.row_names.append("GENE" + std::to_string(i));
+    }
+    for (int j = 0; j < options.cells; j++) {
+        metadata.col_names.append("CELL" + std::to_string(j) + "-1");
+    }
+    return SvtSparseMatrix(std::move(svt), std::move(metadata));
+}
+
+std::string featureId(int i) { return "ENSG" + std::to_string(i); }
+std::string featureSymbol(int i) {
+    return (i < 13 ? "MT-GENE" : "GENE") + std::to_string(i);
+}
+
+void writeMtx(const SvtSparseMatrix &matrix, const std::string &dir) {
+    std::filesystem::create_directories(dir);
+    const MatrixMetadata &metadata = matrix.metadata;
+    std::ofstream mtx(dir + "/matrix.mtx");
+    mtx << "%%MatrixMarket matrix coordinate integer general\n"
+        << metadata.nrow << " " << metadata.ncol << " " << metadata.nval
+        << "\n";
+    for (int j = 0; j < metadata.ncol; j++) {
+        const SvtEntry &col = matrix.svt[j];
+        for (size_t p = 0; p < col[kSvtRowInd].size(); p++) {
+            mtx << col[kSvtRowInd][p] + 1 << " " << j + 1 << " "
+                << col[kSvtValInd][p] << "\n";
+        }
+    }
+    std::ofstream features(dir + "/features.tsv");
+    for (int i = 0; i < metadata.nrow; i++) {
+        features << featureId(i) << "\t" << featureSymbol(i)
+                 << "\tGene Expression\n";
+    }
+    std::ofstream barcodes(dir + "/barcodes.tsv");
+    for (size_t j = 0; j < metadata.col_names.size(); j++) {
+        barcodes << metadata.col_names[j] << "\n";
+    }
+}
+
+void writeCsv(const SvtSparseMatrix &matrix, const std::string &filename) {
+    const MatrixMetadata &metadata = matrix.metadata;
+    std::vector<std::vector<int>> dense(metadata.nrow,
+                                        std::vector<int>(metadata.ncol, 0));
+    for (int j = 0; j < metadata.ncol; j++) {
+        const SvtEntry &col = matrix.svt[j];
+        for (size_t p = 0; p < col[kSvtRowInd].size(); p++) {
+            dense[col[kSvtRowInd][p]][j] = col[kSvtValInd][p];
+        }
+    }
+    std::ofstream csv(filename);
+    for (size_t j = 0; j < metadata.col_names.size(); j++) {
+        csv << "," << metadata.col_names[j];
+    }
+    csv << "\n";
+    for (int i = 0; i < metadata.nrow; i++) {
+        csv << featureId(i);
+        for (int val : dense[i]) {
+            csv << "," << val;
+        }
+        csv << "\n";
+    }
+}
+
+template <typename T>
+void writeH5Dataset(hid_t file, const std::string &name, hid_t type,
+                    const std::vector<T> &data) {
+    const hsize_t size = data.size();
+    hid_t space = H5Screate_simple(1, &size, nullptr);
+    hid_t dataset = H5Dcreate2(file, name.c_str(), type, space, H5P_DEFAULT,
+                               H5P_DEFAULT, H5P_DEFAULT);
+    H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data.data());
+    H5Dclose(dataset);
+    H5Sclose(space);
+}
+
+void writeH5Names(hid_t file, const std::string &name,
+                  const std::vector<std::string> &names) {
+    size_t str_size = 1;
+    for (const auto &s : names) str_size = std::max(str_size, s.size());
+    std::string buffer(names.size() * str_size, '\0');
+    for (size_t i = 0; i < names.size(); i++) {
+        names[i].copy(buffer.data() + i * str_size, str_size);
+    }
+    hid_t type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(type, str_size);
+    H5Tset_strpad(type, H5T_STR_NULLPAD);
+    const hsize_t size = names.size();
+    hid_t space = H5Screate_simple(1, &size, nullptr);
+    hid_t dataset = H5Dcreate2(file, name.c_str(), type, space, H5P_DEFAULT,
+                               H5P_DEFAULT, H5P_DEFAULT);
+    H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.data());
+    H5Dclose(dataset);
+    H5Sclose(space);
+    H5Tclose(type);
+}
+
+void writeH5(const SvtSparseMatrix &matrix, const std::string &filename) {
+    const MatrixMetadata &metadata = matrix.metadata;
+    std::vector<uint32_t> data, indices, indptr(1, 0);
+    for (int j = 0; j < metadata.ncol; j++) {
+        const SvtEntry &col = matrix.svt[j];
+        indices.insert(indices.end(), col[kSvtRowInd].begin(),
+                       col[kSvtRowInd].end());
+        data.insert(data.end(), col[kSvtValInd].begin(),
+                    col[kSvtValInd].end());
+        indptr.push_back(indices.size());
+    }
+    std::vector<std::string> ids, symbols, barcodes;
+    for (int i = 0; i < metadata.nrow; i++) {
+        ids.push_back(featureId(i));
+        symbols.push_back(featureSymbol(i));
+    }
+    for (size_t j = 0; j < metadata.col_names.size(); j++) {
+        barcodes.emplace_back(metadata.col_names[j]);
+    }
+
+    hid_t file =
+        H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    H5Gclose(H5Gcreate2(file, "matrix", H5P_DEFAULT, H5P_DEFAULT,
+                        H5P_DEFAULT));
+    H5Gclose(H5Gcreate2(file, "matrix/features", H5P_DEFAULT, H5P_DEFAULT,
+                        H5P_DEFAULT));
+    writeH5Dataset(file, "matrix/data", H5T_NATIVE_UINT32, data);
+    writeH5Dataset(file, "matrix/indices", H5T_NATIVE_UINT32, indices);
+    writeH5Dataset(file, "matrix/indptr", H5T_NATIVE_UINT32, indptr);
+    writeH5Dataset(file, "matrix/shape", H5T_NATIVE_UINT64,
+                   std::vector<uint64_t>{static_cast<uint64_t>(metadata.nrow),
+                                         static_cast<uint64_t>(metadata.ncol)});
+    writeH5Names(file, "matrix/barcodes", barcodes);
+    writeH5Names(file, "matrix/features/id", ids);
+    writeH5Names(file, "matrix/features/name", symbols);
+    H5Fclose(file);
+}
+
+// Checks that a reader recovers all the non-zero entries of the matrix, so that
+// the benchmarks double as a smoke test of the core library.
+void checkRead(const std::string &path,
+               const smallcount::TenxFileParams &params, size_t nnz) {
+    const smallcount::ReadResult result =
+        smallcount::SparseMatrixFileReader::read(path, params);
+    size_t read_nnz = 0;
+    for (const SvtEntry &col : result.matrix.svt) {
+        read_nnz += col[kSvtRowInd].size();
+    }
+    if (read_nnz != nnz || result.matrix.metadata.nval != nnz) {
+        smallcount::fail("Read %zu non-zero entries from %s (expected %zu).",
+                         read_nnz, path, nnz);
+    }
+}
+
+// Reads a file once with profiling enabled and writes its stages to stderr.
+void profileRead(const std::string &path,
+                 const smallcount::TenxFileParams &params) {
+    smallcount::Profiler profiler;
+    smallcount::Profiler::setActive(&profiler);
+    smallcount::SparseMatrixFileReader::read(path, params);
+    smallcount::Profiler::setActive(nullptr);
+
+    std::fprintf(stderr, "Profile of %s\n", path.c_str());
+    std::fprintf(stderr, "stage,depth,seconds,bytes_read,nnz,allocations,"
+                         "heap_delta,peak_heap\n");
+    for (const smallcount::StageRecord &record : profiler.records()) {
+        std::fprintf(stderr, "%s,%d,%.6f,%.0f,%.0f,%.0f,%.0f,%.0f\n",
+                     record.name.c_str(), record.depth, record.seconds,
+                     record.bytes_read, record.nnz, record.allocations,
+                     record.heap_delta, record.peak_heap);
+    }
+}
+
+// Runs `func` `reps` times and prints a .csv line with its timings.
+void runBenchmark(const Options &options, const std::string &name,
+                  size_t nnz, const std::function<void()> &func) {
+    if (name.find(options.filter) == std::string::npos) {
+        return;
+    }
+    std::vector<double> times_ms;
+    for (int rep = 0; rep < options.reps; rep++) {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        const auto end = std::chrono::steady_clock::now();
+        times_ms.push_back(
+            std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    std::sort(times_ms.begin(), times_ms.end());
+    std::printf("%s,%d,%zu,%.3f,%.3f\n", name.c_str(), options.reps, nnz,
+                times_ms.front(), times_ms[times_ms.size() / 2]);
+    std::fflush(stdout);
+}
+
+// Computes the residuals of a matrix once with profiling enabled, as
+// poissonPca() does for a NativeResiduals object, and writes the heap bytes
+// they retain and the peak heap usage to stderr (NaN without the allocation
+// hooks).
+void profileResidualMemory(const Options &options,
+                           const smallcount::SparseColumns &counts,
+                           const ResidualParams &params,
+                           smallcount::Precision precision,
+                           const std::string &name) {
+    if (name.find(options.filter) == std::string::npos) {
+        return;
+    }
+    smallcount::Profiler profiler;
+    smallcount::Profiler::setActive(&profiler);
+    { smallcount::ResidualMatrix residuals(counts, params, precision); }
+    smallcount::Profiler::setActive(nullptr);
+    for (const smallcount::StageRecord &record : profiler.records()) {
+        if (record.name == "residual_matrix") {
+            std::fprintf(stderr, "Memory of %s: %.0f bytes retained, %.0f "
+                                 "bytes peak heap\n",
+                         name.c_str(), record.heap_delta, record.peak_heap);
+        }
+    }
+}
+
+template <typename T>
+void runKernelBenchmarks(const Options &options, const SvtSparseMatrix &matrix,
+                         const std::string &suffix,
+                         const ResidualParams &params) {
+    const size_t nnz = matrix.metadata.nval;
+    const int nrow = matrix.metadata.nrow;
+    const int ncol = matrix.metadata.ncol;
+    const smallcount::Precision precision =
+        std::is_same_v<T, float> ? smallcount::Precision::kFloat
+                                 : smallcount::Precision::kDouble;
+
+    // Residuals computed once from the counts and stored as T, as held by
+    // the NativeResiduals of poissonPca(), for each residual type.
+    const smallcount::SparseColumns columns =
+        smallcount::columnsFromSvt(matrix);
+    for (ResidualType type : {ResidualType::kPearson, ResidualType::kLog1p}) {
+        ResidualParams type_params = params;
+        type_params.type = type;
+        const std::string name = (type == ResidualType::kPearson
+                                      ? "residual_matrix_pearson_"
+                                      : "residual_matrix_log1p_") +
+                                 suffix;
+        runBenchmark(options, name, nnz, [&] {
+            smallcount::ResidualMatrix residuals(columns, type_params,
+                                                 precision);
+        });
+        profileResidualMemory(options, columns, type_params, precision, name);
+    }
+
+    runBenchmark(options, "csc_from_svt_" + suffix, nnz,
+                 [&] { smallcount::cscFromSvt<T>(matrix); });
+    CscMatrix<T> counts = smallcount::cscFromSvt<T>(matrix);
+    for (ResidualType type :
+         {ResidualType::kPearson, ResidualType::kDeviance}) {
+        ResidualParams type_params = params;
+        type_params.type = type;
+        const std::string name = type == ResidualType::kPearson
+                                     ? "pearson_residuals_"
+                                     : "deviance_residuals_";
+        runBenchmark(options, name + suffix, nnz, [&] {
+            CscMatrix<T> residuals = counts;
+            smallcount::applyResiduals(type_params, &residuals);
+        });
+    }
+
+    CscMatrix<T> residuals = counts;
+    smallcount::applyResiduals(params, &residuals);
+    const smallcount::SparseColumns view =
+        smallcount::columnsFromCsc(residuals);
+    std::mt19937_64 rng(options.seed);
+    std::normal_distribution<double> normal;
+    std::vector<double> v_rows(static_cast<size_t>(nrow) * options.k);
+    std::vector<double> v_cols(static_cast<size_t>(ncol) * options.k);
+    for (double &x : v_rows) x = normal(rng);
+    for (double &x : v_cols) x = normal(rng);
+
+    runBenchmark(options, "tcrossprod_" + suffix, nnz, [&] {
+        std::vector<double> out(static_cast<size_t>(nrow) * nrow, 0);
+        smallcount::tcrossprod(view, out.data());
+    });
+    runBenchmark(options, "crossprod_" + suffix, nnz, [&] {
+        std::vector<double> out(static_cast<size_t>(ncol) * options.k, 0);
+        smallcount::crossprod(view, v_rows.data(), options.k, out.data());
+    });
+    runBenchmark(options, "prod_" + suffix, nnz, [&] {
+        std::vector<double> out(static_cast<size_t>(nrow) * options.k, 0);
+        smallcount::prod(view, v_cols.data(), options.k, out.data());
+    });
+}
+
+void runBenchmarks(const Options &options) {
+    SvtSparseMatrix matrix = generateMatrix(options);
+    const size_t nnz = matrix.metadata.nval;
+    std::cerr << "Generated " << options.genes << " x " << options.cells
+              << " matrix with " << nnz << " non-zero entries" << std::endl;
+
+    // Input files for the readers.
+    const std::string mtx_dir = options.dir + "/mtx/";
+    const std::string csv_file = options.dir + "/matrix.csv";
+    const std::string h5_file = options.dir + "/matrix.h5";
+    writeMtx(matrix, mtx_dir);
+    writeCsv(matrix, csv_file);
+    writeH5(matrix, h5_file);
+
+    smallcount::TenxFileParams params{.use_barcode_col_names = true,
+                                      .use_id_row_names = true,
+                                      .use_features_tsv = true};
+    smallcount::TenxFileParams qc_params = params;
+    qc_params.compute_qc = true;
+    qc_params.mito_pattern = "^MT-";
+
+    checkRead(mtx_dir, params, nnz);
+    checkRead(csv_file, params, nnz);
+    checkRead(h5_file, qc_params, nnz);
+    if (options.profile) {
+        profileRead(mtx_dir, params);
+        profileRead(csv_file, params);
+        profileRead(h5_file, qc_params);
+    }
+
+    std::printf("benchmark,reps,nnz,min_ms,median_ms\n");
+    using Reader = smallcount::SparseMatrixFileReader;
+    runBenchmark(options, "read_mtx", nnz,
+                 [&] { Reader::read(mtx_dir, params); });
+    runBenchmark(options, "read_mtx_qc", nnz,
+                 [&] { Reader::read(mtx_dir, qc_params); });
+    runBenchmark(options, "read_csv", nnz,
+                 [&] { Reader::read(csv_file, params); });
+    runBenchmark(options, "read_h5", nnz,
+                 [&] { Reader::read(h5_file, params); });
+    runBenchmark(options, "read_h5_qc", nnz,
+                 [&] { Reader::read(h5_file, qc_params); });
+
+    // Writers, checked by reading their output back.
+    smallcount::MatrixNames names;
+    for (int i = 0; i < options.genes; i++) {
+        names.feature_ids.append(featureId(i));
+        names.feature_names.append(featureSymbol(i));
+    }
+    names.barcodes = matrix.metadata.col_names;
+    const smallcount::SparseColumns columns =
+        smallcount::columnsFromSvt(matrix);
+    const std::string written_mtx_dir = options.dir + "/written_mtx/";
+    const std::string written_csv_file = options.dir + "/written.csv";
+    const std::string written_h5_file = options.dir + "/written.h5";
+    std::filesystem::create_directories(written_mtx_dir);
+    using Writer = smallcount::SparseMatrixFileWriter;
+    Writer::write(columns, names, written_mtx_dir, /*compress=*/false);
+    Writer::write(columns, names, written_csv_file, /*compress=*/false);
+    Writer::write(columns, names, written_h5_file, /*compress=*/true);
+    checkRead(written_mtx_dir, params, nnz);
+    checkRead(written_csv_file, params, nnz);
+    checkRead(written_h5_file, params, nnz);
+    runBenchmark(options, "write_mtx", nnz, [&] {
+        Writer::write(columns, names, written_mtx_dir, /*compress=*/false);
+    });
+    runBenchmark(options, "write_mtx_gz", nnz, [&] {
+        Writer::write(columns, names, written_mtx_dir, /*compress=*/true);
+    });
+    runBenchmark(options, "write_csv", nnz, [&] {
+        Writer::write(columns, names, written_csv_file, /*compress=*/false);
+    });
+    runBenchmark(options, "write_h5", nnz, [&] {
+        Writer::write(columns, names, written_h5_file, /*compress=*/true);
+    });
+
+    // Row rates and column sums of the Poisson model.
+    std::vector<double> rate(options.genes, 0);
+    std::vector<double> n(options.cells, 0);
+    double total = 0;
+    for (int j = 0; j < options.cells; j++) {
+        const SvtEntry &col = matrix.svt[j];
+        for (size_t p = 0; p < col[kSvtRowInd].size(); p++) {
+            rate[col[kSvtRowInd][p]] += col[kSvtValInd][p];
+            n[j] += col[kSvtValInd][p];
+        }
+        total += n[j];
+    }
+    for (double &r : rate) r /= total;
+
+    // Deviance row sums, as computed by poissonDeviance(), over views of the
+    // SVT and of a dgCMatrix-like copy of it.
+    std::vector<int> col_ptr(options.cells + 1, 0);
+    std::vector<int> row_ind;
+    std::vector<double> values;
+    for (int j = 0; j < options.cells; j++) {
+        const SvtEntry &col = matrix.svt[j];
+        row_ind.insert(row_ind.end(), col[kSvtRowInd].begin(),
+                       col[kSvtRowInd].end());
+        values.insert(values.end(), col[kSvtValInd].begin(),
+                      col[kSvtValInd].end());
+        col_ptr[j + 1] = row_ind.size();
+    }
+    const smallcount::Transformation dev = [](double y, double mu) {
+        return y * std::log(y / mu);
+    };
+    runBenchmark(options, "deviance_row_sums_svt", nnz, [&] {
+        smallcount::rowTransformSums(smallcount::columnsFromSvt(matrix), dev,
+                                     rate.data(), n.data());
+    });
+    runBenchmark(options, "deviance_row_sums_csc", nnz, [&] {
+        smallcount::rowTransformSums(
+            smallcount::columnsFromCsc(options.genes, options.cells,
+                                       col_ptr.data(), row_ind.data(),
+                                       values.data()),
+            dev, rate.data(), n.data());
+    });
+    const smallcount::CsrIndex row_index =
+        smallcount::rowIndex(smallcount::columnsFromSvt(matrix));
+    runBenchmark(options, "row_index_svt", nnz, [&] {
+        smallcount::rowIndex(smallcount::columnsFromSvt(matrix));
+    });
+    runBenchmark(options, "deviance_row_sums_csr", nnz, [&] {
+        smallcount::rowTransformSums(row_index, dev, rate.data(), n.data());
+    });
+    runBenchmark(options, "gene_summaries_svt", nnz, [&] {
+        smallcount::geneSummaries(smallcount::columnsFromSvt(matrix));
+    });
+    std::vector<int> groups(options.cells);
+    for (int j = 0; j < options.cells; j++) {
+        groups[j] = j % 10;
+    }
+    runBenchmark(options, "group_deviance_svt", nnz, [&] {
+        smallcount::groupDeviance(smallcount::columnsFromSvt(matrix),
+                                  groups.data(), 10);
+    });
+    runBenchmark(options, "group_deviance_csr", nnz, [&] {
+        smallcount::groupDeviance(smallcount::columnsFromSvt(matrix),
+                                  groups.data(), 10, &row_index);
+    });
+    runBenchmark(options, "native_from_svt", nnz, [&] {
+        smallcount::NativeMatrix copy(smallcount::columnsFromSvt(matrix));
+    });
+    const smallcount::NativeMatrix native(smallcount::columnsFromSvt(matrix));
+    runBenchmark(options, "deviance_row_sums_native", nnz, [&] {
+        smallcount::rowTransformSums(native.columns(), dev, rate.data(),
+                                     n.data());
+    });
+
+    // kNN graphs of a random cells x k embedding, as from poissonPca().
+    std::mt19937_64 rng(options.seed);
+    std::normal_distribution<double> normal;
+    std::vector<double> embedding(static_cast<size_t>(options.cells) *
+                                  options.k);
+    for (double &value : embedding) {
+        value = normal(rng);
+    }
+    const size_t num_points = options.cells;
+    runBenchmark(options, "knn_exact", num_points, [&] {
+        smallcount::exactKnn(embedding.data(), options.cells, options.k, 15);
+    });
+    runBenchmark(options, "knn_nn_descent", num_points, [&] {
+        smallcount::nnDescentKnn(embedding.data(), options.cells, options.k,
+                                 15, smallcount::NnDescentParams());
+    });
+
+    const ResidualParams residual_params{.type = ResidualType::kPearson,
+                                         .rate = rate.data(),
+                                         .n = n.data()};
+    runKernelBenchmarks<double>(options, matrix, "double", residual_params);
+    runKernelBenchmarks<float>(options, matrix, "float", residual_params);
+
+    std::filesystem::remove_all(options.dir);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    smallcount::setWarningHandler([](const std::string &message) {
+        std::cerr << "Warning: " << message << std::endl;
+    });
+    try {
+        runBenchmarks(parseOptions(argc, argv));
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -13,12 +13,16 @@ Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 // cppReadSparseMatrix
 SEXP cppReadSparseMatrix(std::string sample, bool barcode_col_names,
                          bool id_row_names, std::string genome,
-                         bool use_features_tsv);
+                         bool use_features_tsv, bool compute_qc,
+                         std::string mito_pattern, bool native);
 RcppExport SEXP _smallcount_cppReadSparseMatrix(SEXP sampleSEXP,
                                                 SEXP barcode_col_namesSEXP,
                                                 SEXP id_row_namesSEXP,
                                                 SEXP genomeSEXP,
-                                                SEXP use_features_tsvSEXP) {
+                                                SEXP use_features_tsvSEXP,
+                                                SEXP compute_qcSEXP,
+                                                SEXP mito_patternSEXP,
+                                                SEXP nativeSEXP) {
     BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -29,48 +33,375 @@ RcppExport SEXP _smallcount_cppReadSparseMatrix(SEXP sampleSEXP,
     Rcpp::traits::input_parameter<std::string>::type genome(genomeSEXP);
     Rcpp::traits::input_parameter<bool>::type use_features_tsv(
         use_features_tsvSEXP);
+    Rcpp::traits::input_parameter<bool>::type compute_qc(compute_qcSEXP);
+    Rcpp::traits::input_parameter<std::string>::type mito_pattern(
+        mito_patternSEXP);
+    Rcpp::traits::input_parameter<bool>::type native(nativeSEXP);
     rcpp_result_gen = Rcpp::wrap(cppReadSparseMatrix(
-        sample, barcode_col_names, id_row_names, genome, use_features_tsv));
+        sample, barcode_col_names, id_row_names, genome, use_features_tsv,
+        compute_qc, mito_pattern, native));
     return rcpp_result_gen;
     END_RCPP
 }
-// cppPoissonDevianceTransformation
-List cppPoissonDevianceTransformation(List svt, NumericVector mu);
-RcppExport SEXP _smallcount_cppPoissonDevianceTransformation(SEXP svtSEXP,
-                                                             SEXP muSEXP) {
+// cppWriteSparseMatrix
+void cppWriteSparseMatrix(SEXP y, std::string sample,
+                          CharacterVector feature_ids,
+                          CharacterVector feature_names,
+                          CharacterVector barcodes, bool compress);
+RcppExport SEXP _smallcount_cppWriteSparseMatrix(SEXP ySEXP, SEXP sampleSEXP,
+                                                 SEXP feature_idsSEXP,
+                                                 SEXP feature_namesSEXP,
+                                                 SEXP barcodesSEXP,
+                                                 SEXP compressSEXP) {
+    BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type y(ySEXP);
+    Rcpp::traits::input_parameter<std::string>::type sample(sampleSEXP);
+    Rcpp::traits::input_parameter<CharacterVector>::type feature_ids(
+        feature_idsSEXP);
+    Rcpp::traits::input_parameter<CharacterVector>::type feature_names(
+        feature_namesSEXP);
+    Rcpp::traits::input_parameter<CharacterVector>::type barcodes(barcodesSEXP);
+    Rcpp::traits::input_parameter<bool>::type compress(compressSEXP);
+    cppWriteSparseMatrix(y, sample, feature_ids, feature_names, barcodes,
+                         compress);
+    return R_NilValue;
+    END_RCPP
+}
+// cppNativeSparseMatrix
+SEXP cppNativeSparseMatrix(SEXP y, SEXP dim_names);
+RcppExport SEXP _smallcount_cppNativeSparseMatrix(SEXP ySEXP,
+                                                  SEXP dim_namesSEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type y(ySEXP);
+    Rcpp::traits::input_parameter<SEXP>::type dim_names(dim_namesSEXP);
+    rcpp_result_gen = Rcpp::wrap(cppNativeSparseMatrix(y, dim_names));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppNativeToSvt
+SEXP cppNativeToSvt(SEXP x);
+RcppExport SEXP _smallcount_cppNativeToSvt(SEXP xSEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(cppNativeToSvt(x));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppRowIndex
+SEXP cppRowIndex(SEXP y);
+RcppExport SEXP _smallcount_cppRowIndex(SEXP ySEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type y(ySEXP);
+    rcpp_result_gen = Rcpp::wrap(cppRowIndex(y));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppColSums
+NumericVector cppColSums(SEXP y);
+RcppExport SEXP _smallcount_cppColSums(SEXP ySEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type y(ySEXP);
+    rcpp_result_gen = Rcpp::wrap(cppColSums(y));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppRowSums
+NumericVector cppRowSums(SEXP y);
+RcppExport SEXP _smallcount_cppRowSums(SEXP ySEXP) {
     BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter<List>::type svt(svtSEXP);
-    Rcpp::traits::input_parameter<NumericVector>::type mu(muSEXP);
-    rcpp_result_gen = Rcpp::wrap(cppPoissonDevianceTransformation(svt, mu));
+    Rcpp::traits::input_parameter<SEXP>::type y(ySEXP);
+    rcpp_result_gen = Rcpp::wrap(cppRowSums(y));
     return rcpp_result_gen;
     END_RCPP
 }
-// cppPoissonDispersionTransformation
-List cppPoissonDispersionTransformation(List svt, NumericVector mu);
-RcppExport SEXP _smallcount_cppPoissonDispersionTransformation(SEXP svtSEXP,
-                                                               SEXP muSEXP) {
+// cppDevianceRowSums
+NumericVector cppDevianceRowSums(SEXP y, NumericVector rate, NumericVector n);
+RcppExport SEXP _smallcount_cppDevianceRowSums(SEXP ySEXP, SEXP rateSEXP,
+                                               SEXP nSEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type y(ySEXP);
+    Rcpp::traits::input_parameter<NumericVector>::type rate(rateSEXP);
+    Rcpp::traits::input_parameter<NumericVector>::type n(nSEXP);
+    rcpp_result_gen = Rcpp::wrap(cppDevianceRowSums(y, rate, n));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppDispersionRowSums
+NumericVector cppDispersionRowSums(SEXP y, NumericVector rate, NumericVector n);
+RcppExport SEXP _smallcount_cppDispersionRowSums(SEXP ySEXP, SEXP rateSEXP,
+                                                 SEXP nSEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type y(ySEXP);
+    Rcpp::traits::input_parameter<NumericVector>::type rate(rateSEXP);
+    Rcpp::traits::input_parameter<NumericVector>::type n(nSEXP);
+    rcpp_result_gen = Rcpp::wrap(cppDispersionRowSums(y, rate, n));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppGroupRowSums
+NumericMatrix cppGroupRowSums(SEXP y, IntegerVector groups, int num_groups);
+RcppExport SEXP _smallcount_cppGroupRowSums(SEXP ySEXP, SEXP groupsSEXP,
+                                            SEXP num_groupsSEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type y(ySEXP);
+    Rcpp::traits::input_parameter<IntegerVector>::type groups(groupsSEXP);
+    Rcpp::traits::input_parameter<int>::type num_groups(num_groupsSEXP);
+    rcpp_result_gen = Rcpp::wrap(cppGroupRowSums(y, groups, num_groups));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppGroupDeviance
+List cppGroupDeviance(SEXP y, IntegerVector groups, int num_groups);
+RcppExport SEXP _smallcount_cppGroupDeviance(SEXP ySEXP, SEXP groupsSEXP,
+                                             SEXP num_groupsSEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type y(ySEXP);
+    Rcpp::traits::input_parameter<IntegerVector>::type groups(groupsSEXP);
+    Rcpp::traits::input_parameter<int>::type num_groups(num_groupsSEXP);
+    rcpp_result_gen = Rcpp::wrap(cppGroupDeviance(y, groups, num_groups));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppGeneSummaries
+DataFrame cppGeneSummaries(SEXP y);
+RcppExport SEXP _smallcount_cppGeneSummaries(SEXP ySEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type y(ySEXP);
+    rcpp_result_gen = Rcpp::wrap(cppGeneSummaries(y));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppTopK
+IntegerVector cppTopK(NumericVector values, int k);
+RcppExport SEXP _smallcount_cppTopK(SEXP valuesSEXP, SEXP kSEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<NumericVector>::type values(valuesSEXP);
+    Rcpp::traits::input_parameter<int>::type k(kSEXP);
+    rcpp_result_gen = Rcpp::wrap(cppTopK(values, k));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppKnnGraph
+List cppKnnGraph(NumericMatrix x, int k, std::string method, int max_iterations,
+                 double sample_rate, double delta, int seed);
+RcppExport SEXP _smallcount_cppKnnGraph(SEXP xSEXP, SEXP kSEXP, SEXP methodSEXP,
+                                        SEXP max_iterationsSEXP,
+                                        SEXP sample_rateSEXP, SEXP deltaSEXP,
+                                        SEXP seedSEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<NumericMatrix>::type x(xSEXP);
+    Rcpp::traits::input_parameter<int>::type k(kSEXP);
+    Rcpp::traits::input_parameter<std::string>::type method(methodSEXP);
+    Rcpp::traits::input_parameter<int>::type max_iterations(max_iterationsSEXP);
+    Rcpp::traits::input_parameter<double>::type sample_rate(sample_rateSEXP);
+    Rcpp::traits::input_parameter<double>::type delta(deltaSEXP);
+    Rcpp::traits::input_parameter<int>::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(
+        cppKnnGraph(x, k, method, max_iterations, sample_rate, delta, seed));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppResidualMatrix
+SEXP cppResidualMatrix(SEXP y, std::string residual, NumericVector rate,
+                       NumericVector n, double coef, std::string precision);
+RcppExport SEXP _smallcount_cppResidualMatrix(SEXP ySEXP, SEXP residualSEXP,
+                                              SEXP rateSEXP, SEXP nSEXP,
+                                              SEXP coefSEXP,
+                                              SEXP precisionSEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type y(ySEXP);
+    Rcpp::traits::input_parameter<std::string>::type residual(residualSEXP);
+    Rcpp::traits::input_parameter<NumericVector>::type rate(rateSEXP);
+    Rcpp::traits::input_parameter<NumericVector>::type n(nSEXP);
+    Rcpp::traits::input_parameter<double>::type coef(coefSEXP);
+    Rcpp::traits::input_parameter<std::string>::type precision(precisionSEXP);
+    rcpp_result_gen = Rcpp::wrap(
+        cppResidualMatrix(y, residual, rate, n, coef, precision));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppScaleResidualRows
+NumericVector cppScaleResidualRows(SEXP x, NumericVector row_scale);
+RcppExport SEXP _smallcount_cppScaleResidualRows(SEXP xSEXP,
+                                                 SEXP row_scaleSEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type x(xSEXP);
+    Rcpp::traits::input_parameter<NumericVector>::type row_scale(row_scaleSEXP);
+    rcpp_result_gen = Rcpp::wrap(cppScaleResidualRows(x, row_scale));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppResidualTcrossprod
+NumericMatrix cppResidualTcrossprod(SEXP y, std::string residual,
+                                    NumericVector rate, NumericVector n,
+                                    std::string precision);
+RcppExport SEXP _smallcount_cppResidualTcrossprod(SEXP ySEXP, SEXP residualSEXP,
+                                                  SEXP rateSEXP, SEXP nSEXP,
+                                                  SEXP precisionSEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type y(ySEXP);
+    Rcpp::traits::input_parameter<std::string>::type residual(residualSEXP);
+    Rcpp::traits::input_parameter<NumericVector>::type rate(rateSEXP);
+    Rcpp::traits::input_parameter<NumericVector>::type n(nSEXP);
+    Rcpp::traits::input_parameter<std::string>::type precision(precisionSEXP);
+    rcpp_result_gen = Rcpp::wrap(
+        cppResidualTcrossprod(y, residual, rate, n, precision));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppResidualCrossprod
+NumericMatrix cppResidualCrossprod(SEXP y, std::string residual,
+                                   NumericVector rate, NumericVector n,
+                                   NumericMatrix v, std::string precision);
+RcppExport SEXP _smallcount_cppResidualCrossprod(SEXP ySEXP, SEXP residualSEXP,
+                                                 SEXP rateSEXP, SEXP nSEXP,
+                                                 SEXP vSEXP,
+                                                 SEXP precisionSEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type y(ySEXP);
+    Rcpp::traits::input_parameter<std::string>::type residual(residualSEXP);
+    Rcpp::traits::input_parameter<NumericVector>::type rate(rateSEXP);
+    Rcpp::traits::input_parameter<NumericVector>::type n(nSEXP);
+    Rcpp::traits::input_parameter<NumericMatrix>::type v(vSEXP);
+    Rcpp::traits::input_parameter<std::string>::type precision(precisionSEXP);
+    rcpp_result_gen = Rcpp::wrap(
+        cppResidualCrossprod(y, residual, rate, n, v, precision));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppResidualProd
+NumericMatrix cppResidualProd(SEXP y, std::string residual, NumericVector rate,
+                              NumericVector n, NumericMatrix v,
+                              std::string precision);
+RcppExport SEXP _smallcount_cppResidualProd(SEXP ySEXP, SEXP residualSEXP,
+                                            SEXP rateSEXP, SEXP nSEXP,
+                                            SEXP vSEXP, SEXP precisionSEXP) {
+    BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<SEXP>::type y(ySEXP);
+    Rcpp::traits::input_parameter<std::string>::type residual(residualSEXP);
+    Rcpp::traits::input_parameter<NumericVector>::type rate(rateSEXP);
+    Rcpp::traits::input_parameter<NumericVector>::type n(nSEXP);
+    Rcpp::traits::input_parameter<NumericMatrix>::type v(vSEXP);
+    Rcpp::traits::input_parameter<std::string>::type precision(precisionSEXP);
+    rcpp_result_gen = Rcpp::wrap(
+        cppResidualProd(y, residual, rate, n, v, precision));
+    return rcpp_result_gen;
+    END_RCPP
+}
+// cppSetProfiling
+void cppSetProfiling(bool enabled);
+RcppExport SEXP _smallcount_cppSetProfiling(SEXP enabledSEXP) {
+    BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<bool>::type enabled(enabledSEXP);
+    cppSetProfiling(enabled);
+    return R_NilValue;
+    END_RCPP
+}
+// cppProfileBegin
+void cppProfileBegin(std::string name);
+RcppExport SEXP _smallcount_cppProfileBegin(SEXP nameSEXP) {
+    BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter<std::string>::type name(nameSEXP);
+    cppProfileBegin(name);
+    return R_NilValue;
+    END_RCPP
+}
+// cppProfileEnd
+void cppProfileEnd();
+RcppExport SEXP _smallcount_cppProfileEnd() {
+    BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    cppProfileEnd();
+    return R_NilValue;
+    END_RCPP
+}
+// cppProfileRecords
+DataFrame cppProfileRecords();
+RcppExport SEXP _smallcount_cppProfileRecords() {
     BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter<List>::type svt(svtSEXP);
-    Rcpp::traits::input_parameter<NumericVector>::type mu(muSEXP);
-    rcpp_result_gen = Rcpp::wrap(cppPoissonDispersionTransformation(svt, mu));
+    rcpp_result_gen = Rcpp::wrap(cppProfileRecords());
     return rcpp_result_gen;
     END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
     {"_smallcount_cppReadSparseMatrix",
-     (DL_FUNC)&_smallcount_cppReadSparseMatrix, 5},
-    {"_smallcount_cppPoissonDevianceTransformation",
-     (DL_FUNC)&_smallcount_cppPoissonDevianceTransformation, 2},
-    {"_smallcount_cppPoissonDispersionTransformation",
-     (DL_FUNC)&_smallcount_cppPoissonDispersionTransformation, 2},
+     (DL_FUNC)&_smallcount_cppReadSparseMatrix, 8},
+    {"_smallcount_cppWriteSparseMatrix",
+     (DL_FUNC)&_smallcount_cppWriteSparseMatrix, 6},
+    {"_smallcount_cppNativeSparseMatrix",
+     (DL_FUNC)&_smallcount_cppNativeSparseMatrix, 2},
+    {"_smallcount_cppNativeToSvt", (DL_FUNC)&_smallcount_cppNativeToSvt, 1},
+    {"_smallcount_cppRowIndex", (DL_FUNC)&_smallcount_cppRowIndex, 1},
+    {"_smallcount_cppColSums", (DL_FUNC)&_smallcount_cppColSums, 1},
+    {"_smallcount_cppRowSums", (DL_FUNC)&_smallcount_cppRowSums, 1},
+    {"_smallcount_cppDevianceRowSums",
+     (DL_FUNC)&_smallcount_cppDevianceRowSums, 3},
+    {"_smallcount_cppDispersionRowSums",
+     (DL_FUNC)&_smallcount_cppDispersionRowSums, 3},
+    {"_smallcount_cppGroupRowSums", (DL_FUNC)&_smallcount_cppGroupRowSums, 3},
+    {"_smallcount_cppGroupDeviance", (DL_FUNC)&_smallcount_cppGroupDeviance, 3},
+    {"_smallcount_cppGeneSummaries", (DL_FUNC)&_smallcount_cppGeneSummaries, 1},
+    {"_smallcount_cppTopK", (DL_FUNC)&_smallcount_cppTopK, 2},
+    {"_smallcount_cppKnnGraph", (DL_FUNC)&_smallcount_cppKnnGraph, 7},
+    {"_smallcount_cppResidualMatrix",
+     (DL_FUNC)&_smallcount_cppResidualMatrix, 6},
+    {"_smallcount_cppScaleResidualRows",
+     (DL_FUNC)&_smallcount_cppScaleResidualRows, 2},
+    {"_smallcount_cppResidualTcrossprod",
+     (DL_FUNC)&_smallcount_cppResidualTcrossprod, 5},
+    {"_smallcount_cppResidualCrossprod",
+     (DL_FUNC)&_smallcount_cppResidualCrossprod, 6},
+    {"_smallcount_cppResidualProd", (DL_FUNC)&_smallcount_cppResidualProd, 6},
+    {"_smallcount_cppSetProfiling", (DL_FUNC)&_smallcount_cppSetProfiling, 1},
+    {"_smallcount_cppProfileBegin", (DL_FUNC)&_smallcount_cppProfileBegin, 1},
+    {"_smallcount_cppProfileEnd", (DL_FUNC)&_smallcount_cppProfileEnd, 0},
+    {"_smallcount_cppProfileRecords",
+     (DL_FUNC)&_smallcount_cppProfileRecords, 0},
     {NULL, NULL, 0}};
 
+void installWarningHandler(DllInfo* dll);
 RcppExport void R_init_smallcount(DllInfo* dll) {
     R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
     R_useDynamicSymbols(dll, FALSE);
+    installWarningHandler(dll);
 }
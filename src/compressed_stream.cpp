@@ -0,0 +1,165 @@
+#include "compressed_stream.h"
+
+#include <algorithm>
+#include <memory>
+#include <streambuf>
+#include <vector>
+
+#include "bzlib.h"
+#include "error.h"
+#include "zlib.h"
+
+namespace smallcount {
+
+// Bytes read from the source, and decompressed, at once.
+static constexpr size_t kBufferSize = 1 << 16;
+
+class DecompressingStreamBuf::Decoder {
+   public:
+    virtual ~Decoder() = default;
+    // Decompresses the bytes in [*next_in, *next_in + *avail_in) into `out`,
+    // advancing `next_in`, and returns the number of bytes written. Sets
+    // `*stream_end` if the end of a compressed stream is reached.
+    virtual size_t decode(const char **next_in, size_t *avail_in, char *out,
+                          size_t out_size, bool *stream_end) = 0;
+    // Prepares the decoder for a concatenated stream.
+    virtual void reset() = 0;
+};
+
+class DecompressingStreamBuf::GzipDecoder : public Decoder {
+   public:
+    GzipDecoder() {
+        // Reads gzip (or zlib) headers.
+        if (inflateInit2(&stream, /*windowBits=*/15 + 32) != Z_OK) {
+            fail("Could not initialize zlib.");
+        }
+    }
+    ~GzipDecoder() override { inflateEnd(&stream); }
+
+    size_t decode(const char **next_in, size_t *avail_in, char *out,
+                  size_t out_size, bool *stream_end) override {
+        stream.next_in =
+            reinterpret_cast<Bytef *>(const_cast<char *>(*next_in));
+        stream.avail_in = *avail_in;
+        stream.next_out = reinterpret_cast<Bytef *>(out);
+        stream.avail_out = out_size;
+        const int status = inflate(&stream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+            fail("Invalid gzip data (%s).",
+                 stream.msg == nullptr ? "unknown error" : stream.msg);
+        }
+        *stream_end = status == Z_STREAM_END;
+        *next_in += *avail_in - stream.avail_in;
+        *avail_in = stream.avail_in;
+        return out_size - stream.avail_out;
+    }
+
+    void reset() override { inflateReset(&stream); }
+
+   private:
+    z_stream stream{};
+};
+
+class DecompressingStreamBuf::Bzip2Decoder : public Decoder {
+   public:
+    Bzip2Decoder() { init(); }
+    ~Bzip2Decoder() override { BZ2_bzDecompressEnd(&stream); }
+
+    size_t decode(const char **next_in, size_t *avail_in, char *out,
+                  size_t out_size, bool *stream_end) override {
+        stream.next_in = const_cast<char *>(*next_in);
+        stream.avail_in = *avail_in;
+        stream.next_out = out;
+        stream.avail_out = out_size;
+        const int status = BZ2_bzDecompress(&stream);
+        if (status != BZ_OK && status != BZ_STREAM_END) {
+            fail("Invalid bzip2 data (error %d).", status);
+        }
+        *stream_end = status == BZ_STREAM_END;
+        *next_in += *avail_in - stream.avail_in;
+        *avail_in = stream.avail_in;
+        return out_size - stream.avail_out;
+    }
+
+    void reset() override {
+        BZ2_bzDecompressEnd(&stream);
+        init();
+    }
+
+   private:
+    void init() {
+        stream = bz_stream{};
+        if (BZ2_bzDecompressInit(&stream, /*verbosity=*/0, /*small=*/0) !=
+            BZ_OK) {
+            fail("Could not initialize bzip2.");
+        }
+    }
+
+    bz_stream stream{};
+};
+
+DecompressingStreamBuf::DecompressingStreamBuf(std::streambuf *source,
+                                               Compression compression)
+    : source(source), in(kBufferSize), out(kBufferSize) {
+    if (compression == Compression::kGzip) {
+        decoder = std::make_unique<GzipDecoder>();
+    } else if (compression == Compression::kBzip2) {
+        decoder = std::make_unique<Bzip2Decoder>();
+    }
+    setg(out.data(), out.data(), out.data());
+}
+
+DecompressingStreamBuf::~DecompressingStreamBuf() = default;
+
+bool DecompressingStreamBuf::refill() {
+    in_pos = 0;
+    in_size = source->sgetn(in.data(), in.size());
+    bytes_read += in_size;
+    return in_size > 0;
+}
+
+DecompressingStreamBuf::int_type DecompressingStreamBuf::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    if (decoder == nullptr) {
+        // Uncompressed: pass the bytes of the source through.
+        if (!refill()) {
+            return traits_type::eof();
+        }
+        std::copy(in.begin(), in.begin() + in_size, out.begin());
+        setg(out.data(), out.data(), out.data() + in_size);
+        return traits_type::to_int_type(*gptr());
+    }
+    while (true) {
+        if (in_pos == in_size && !refill()) {
+            if (in_stream) {
+                fail("Unexpected end of compressed data.");
+            }
+            return traits_type::eof();
+        }
+        if (!in_stream) {
+            // More data follows the end of a stream: a concatenated stream.
+            decoder->reset();
+            in_stream = true;
+        }
+        const char *next_in = in.data() + in_pos;
+        size_t avail_in = in_size - in_pos;
+        bool stream_end = false;
+        const size_t produced =
+            decoder->decode(&next_in, &avail_in, out.data(), out.size(),
+                            &stream_end);
+        const size_t consumed = (in_size - in_pos) - avail_in;
+        in_pos += consumed;
+        in_stream = !stream_end;
+        if (produced > 0) {
+            setg(out.data(), out.data(), out.data() + produced);
+            return traits_type::to_int_type(*gptr());
+        }
+        if (consumed == 0 && !stream_end) {
+            fail("Invalid compressed data.");
+        }
+    }
+}
+
+}  // namespace smallcount
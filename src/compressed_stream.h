@@ -0,0 +1,54 @@
+#ifndef SMALLCOUNT_COMPRESSED_STREAM_H_
+#define SMALLCOUNT_COMPRESSED_STREAM_H_
+
+#include <memory>
+#include <streambuf>
+#include <vector>
+
+namespace smallcount {
+
+// Compression format of a stream.
+enum class Compression { kNone, kGzip, kBzip2 };
+
+// Input stream buffer that decompresses the bytes of another stream buffer
+// (e.g., a file or a member of a tar archive) as they are read, so that the
+// decompressed data is never written to disk. Concatenated gzip members and
+// bzip2 streams are read as a single stream, as by gzip and bzip2.
+class DecompressingStreamBuf : public std::streambuf {
+   public:
+    // Reads from `source`, which must outlive the stream buffer.
+    DecompressingStreamBuf(std::streambuf *source, Compression compression);
+    ~DecompressingStreamBuf() override;
+    DecompressingStreamBuf(const DecompressingStreamBuf &) = delete;
+    DecompressingStreamBuf &operator=(const DecompressingStreamBuf &) = delete;
+
+    // Compressed bytes read from the source so far.
+    size_t bytesRead() const { return bytes_read; }
+
+   protected:
+    int_type underflow() override;
+
+   private:
+    // Decompressor state of each format (defined in the .cpp file).
+    class Decoder;
+    class GzipDecoder;
+    class Bzip2Decoder;
+
+    // Reads the next block of compressed bytes, returning false at the end
+    // of the source.
+    bool refill();
+
+    std::streambuf *source;
+    std::unique_ptr<Decoder> decoder;
+    std::vector<char> in;   // Compressed bytes
+    std::vector<char> out;  // Decompressed bytes, exposed as the get area
+    size_t in_pos = 0;      // Next compressed byte to decode
+    size_t in_size = 0;     // Compressed bytes in `in`
+    // Whether a compressed stream was started but has not ended yet.
+    bool in_stream = true;
+    size_t bytes_read = 0;
+};
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_COMPRESSED_STREAM_H_
@@ -0,0 +1,100 @@
+#ifndef SMALLCOUNT_CSC_MATRIX_H_
+#define SMALLCOUNT_CSC_MATRIX_H_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "residuals.h"
+#include "sparse_columns.h"
+#include "sparse_matrix.h"
+
+namespace smallcount {
+
+// Compressed sparse column matrix with values of type T (float or double).
+// Used as a contiguous copy of the residuals of a sparse matrix for the
+// numeric kernels.
+template <typename T>
+struct CscMatrix {
+    int nrow = 0;
+    int ncol = 0;
+    std::vector<size_t> col_ptr;  // Offset of each column (size ncol + 1)
+    std::vector<int> row_ind;     // Row index of each non-zero entry
+    std::vector<T> values;        // Value of each non-zero entry
+};
+
+// Parameters of the residuals computed from the non-zero counts of a matrix.
+struct ResidualParams {
+    ResidualType type;
+    const double *rate = nullptr;  // Row-wise rates (Pearson and deviance)
+    const double *n = nullptr;     // Column sums (Pearson and deviance)
+    double coef = 1;               // Scale of the counts (log1p only)
+};
+
+// Residual of a non-zero count `y` in row i and column j.
+inline double residual(const ResidualParams &params, double y, int i, int j) {
+    if (params.type == ResidualType::kLog1p) {
+        return std::log1p(params.coef * y);
+    }
+    if (!needsModel(params.type)) {
+        return y;
+    }
+    return residual(params.type, y, params.rate[i], params.n[j]);
+}
+
+// Copies the non-zero entries of a sparse matrix view into a CSC matrix with
+// values of type T.
+template <typename T>
+CscMatrix<T> cscFromColumns(const SparseColumns &view) {
+    CscMatrix<T> matrix;
+    matrix.nrow = view.nrow;
+    matrix.ncol = view.ncol;
+    matrix.col_ptr.assign(matrix.ncol + 1, 0);
+    matrix.row_ind.resize(view.nnz());
+    matrix.values.resize(view.nnz());
+    size_t offset = 0;
+    for (int i = 0; i < matrix.ncol; i++) {
+        const SparseColumn &column = view.columns[i];
+        matrix.col_ptr[i] = offset;
+        std::copy_n(column.rows, column.nnz, matrix.row_ind.begin() + offset);
+        column.forEach([&](int, double value) {
+            matrix.values[offset++] = static_cast<T>(value);
+        });
+    }
+    matrix.col_ptr[matrix.ncol] = offset;
+    return matrix;
+}
+
+// Views the columns of a CSC matrix, which must outlive the view.
+template <typename T>
+SparseColumns columnsFromCsc(const CscMatrix<T> &matrix) {
+    return columnsFromCsc(matrix.nrow, matrix.ncol, matrix.col_ptr.data(),
+                          matrix.row_ind.data(), matrix.values.data());
+}
+
+// Builds a CSC matrix from an SVT whose row indices are sorted.
+template <typename T>
+CscMatrix<T> cscFromSvt(const SvtSparseMatrix &svt_matrix) {
+    return cscFromColumns<T>(columnsFromSvt(svt_matrix));
+}
+
+// Replaces the non-zero counts of a CSC matrix with their residuals. Counts
+// are exactly representable in float up to 2^24, so the residuals do not
+// depend on the storage precision.
+template <typename T>
+void applyResiduals(const ResidualParams &params, CscMatrix<T> *matrix) {
+    if (params.type == ResidualType::kIdentity) {
+        return;
+    }
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < matrix->ncol; i++) {
+        for (size_t p = matrix->col_ptr[i]; p < matrix->col_ptr[i + 1]; p++) {
+            matrix->values[p] = static_cast<T>(residual(
+                params, matrix->values[p], matrix->row_ind[p], i));
+        }
+    }
+}
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_CSC_MATRIX_H_
@@ -0,0 +1,67 @@
+#include "csr_index.h"
+
+#include <vector>
+
+#include "parallel.h"
+#include "profiler.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+CsrIndex rowIndex(const SparseColumns &view) {
+    ScopedStage stage("row_index");
+    CsrIndex index;
+    index.nrow = view.nrow;
+    index.ncol = view.ncol;
+    index.row_ptr.assign(static_cast<size_t>(view.nrow) + 1, 0);
+
+    // Entries of each row in the columns of each thread, then the offset at
+    // which each thread writes the entries of each row.
+    std::vector<std::vector<size_t>> offsets;
+#pragma omp parallel
+    {
+        const int num_threads = threadCount();
+        const int thread = threadIndex();
+#pragma omp single
+        offsets.resize(num_threads);
+
+        std::vector<size_t> &thread_offsets = offsets[thread];
+        thread_offsets.assign(view.nrow, 0);
+        const size_t ncol = view.ncol;
+        const int begin = ncol * thread / num_threads;
+        const int end = ncol * (thread + 1) / num_threads;
+        for (int j = begin; j < end; j++) {
+            view.columns[j].forEach(
+                [&](int row, double) { thread_offsets[row]++; });
+        }
+#pragma omp barrier
+
+#pragma omp single
+        {
+            size_t offset = 0;
+            for (int i = 0; i < view.nrow; i++) {
+                index.row_ptr[i] = offset;
+                for (std::vector<size_t> &counts : offsets) {
+                    const size_t count = counts[i];
+                    counts[i] = offset;
+                    offset += count;
+                }
+            }
+            index.row_ptr[view.nrow] = offset;
+            index.col_ind.resize(offset);
+            index.values.resize(offset);
+        }
+
+        for (int j = begin; j < end; j++) {
+            view.columns[j].forEach([&](int row, double value) {
+                const size_t p = thread_offsets[row]++;
+                index.col_ind[p] = j;
+                index.values[p] = value;
+            });
+        }
+    }
+    stage.addNnz(index.nnz());
+    return index;
+}
+
+}  // namespace smallcount
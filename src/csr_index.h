@@ -0,0 +1,40 @@
+#ifndef SMALLCOUNT_CSR_INDEX_H_
+#define SMALLCOUNT_CSR_INDEX_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+// Row-oriented (CSR) copy of the non-zero entries of a column-oriented sparse
+// matrix, so that row-wise kernels read each row sequentially instead of
+// scattering writes across rows. Row offsets are size_t, so matrices with more
+// than 2^31 non-zero entries are supported.
+struct CsrIndex {
+    int nrow = 0;
+    int ncol = 0;
+    std::vector<size_t> row_ptr;  // Offsets of each row (size nrow + 1)
+    std::vector<int> col_ind;     // Column indices, sorted within each row
+    std::vector<double> values;   // Non-zero values
+
+    size_t nnz() const { return col_ind.size(); }
+
+    // Calls `f(col, value)` for each non-zero entry of row i.
+    template <typename F>
+    void forEachInRow(int i, F &&f) const {
+        for (size_t p = row_ptr[i]; p < row_ptr[i + 1]; p++) {
+            f(col_ind[p], values[p]);
+        }
+    }
+};
+
+// Builds the row index of a matrix in parallel: each thread counts, then
+// fills, the entries of a contiguous range of columns, so the columns within
+// each row stay sorted without a final sort.
+CsrIndex rowIndex(const SparseColumns &view);
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_CSR_INDEX_H_
@@ -4,15 +4,17 @@
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
-#include <fstream>
+#include <istream>
 #include <string>
+#include <string_view>
 #include <vector>
 
-#include "Rcpp.h"
+#include "error.h"
+#include "name_table.h"
+#include "profiler.h"
+#include "qc_metrics.h"
 #include "sparse_matrix.h"
 
-using namespace Rcpp;
-
 namespace smallcount {
 namespace {
 
@@ -31,21 +33,21 @@ struct CsvLine {
 };
 
 // Returns the column names given in the first line of a .csv file.
-std::vector<std::string> readColumnNames(const std::string &line) {
-    std::vector<std::string> col_names;
+NameTable readColumnNames(const std::string &line) {
+    NameTable col_names;
     // Skip the top-left corner of the .csv file.
     const char *val_start = strchr(line.c_str(), ',');
     if (val_start == nullptr) {
-        stop("No comma delimiter on line 1.");
+        fail("No comma delimiter on line 1.");
     }
     // Read the column names.
     while (true) {
         val_start++;
         const char *val_end = strchr(val_start, ',');
         if (val_end != nullptr) {
-            col_names.emplace_back(val_start, val_end);
+            col_names.append(std::string_view(val_start, val_end - val_start));
         } else {
-            col_names.emplace_back(val_start);
+            col_names.append(std::string_view(val_start));
             break;
         }
         val_start = val_end;
@@ -54,40 +56,55 @@ std::vector<std::string> readColumnNames(const std::string &line) {
 }
 
 // Reads the row name and non-zero data given in a line of a .csv file,
-// directly adding entries to the provided SVT matrix.
+// directly adding entries to the provided SVT matrix (and QC metrics, if
+// non-null).
 void parseCsvLine(const std::string &line, int ncol, int line_num, int row_idx,
-                  Svt &svt, std::string &row_name, size_t *nval) {
+                  Svt &svt, NameTable &row_names, size_t *nval,
+                  QcMetrics *qc) {
     // Read the row name.
     const char *val_start = strchr(line.c_str(), ',');
     if (val_start == nullptr) {
-        stop("No comma delimiter on line %d.", line_num);
+        fail("No comma delimiter on line %d.", line_num);
+    }
+    const std::string_view row_name(line.c_str(), val_start - line.c_str());
+    row_names.append(row_name);
+    if (qc != nullptr) {
+        qc->addRow(row_name);
     }
-    row_name = std::string(line.c_str(), val_start);
 
     // Read the row data.
     char *val_end;
     int col = 0;
     while (*val_start != '\0') {
+        if (col == ncol) {
+            fail(
+                "Inconsistent column count. Expected %d columns (from header) "
+                "but encountered more in row %d.",
+                ncol, line_num);
+        }
         // Read the next value, skipping over the comma.
         double val = strtof(val_start + 1, &val_end);
         while (*val_end != '\0' && *val_end != ',') {
             val_end++;
         }
         if (trunc(val) != val) {
-            stop(
+            fail(
                 "Unexpected float value. Expected integer in row %d, column %d "
                 "but encountered a floating-point number: %f.",
                 line_num, col + 2, val);
         } else if (val != 0) {
             svt[col][kSvtRowInd].emplace_back(row_idx);
             svt[col][kSvtValInd].emplace_back(val);
+            if (qc != nullptr) {
+                qc->add(row_idx, col, val);
+            }
             (*nval)++;
         }
         val_start = val_end;
         col++;
     }
     if (col != ncol) {
-        stop(
+        fail(
             "Inconsistent column count. Expected %d columns (from header) but "
             "encountered %d in row %d.",
             ncol, col, line_num);
@@ -96,30 +113,36 @@ void parseCsvLine(const std::string &line, int ncol, int line_num, int row_idx,
 
 }  // namespace
 
-SvtSparseMatrix CsvFileReader::read(std::ifstream &file) {
+SvtSparseMatrix CsvFileReader::read(std::istream &file, QcMetrics *qc) {
+    ScopedStage stage("csv");
     Svt svt;
-    std::vector<std::string> col_names;
-    std::vector<std::string> row_names;
+    NameTable col_names;
+    NameTable row_names;
     int ncol = 0;
     size_t nval = 0;
 
     std::string line;
     int line_num = 0;
+    size_t bytes_read = 0;
     while (std::getline(file, line)) {
         line_num++;
+        bytes_read += line.size() + 1;
         if (line_num > 1) {
             // Initialize each column with two vectors (rows and values)
             if (svt.empty()) svt = Svt(ncol, SvtEntry(2));
-            std::string row_name;
             parseCsvLine(line, /*ncol=*/ncol, /*line_num=*/line_num,
-                         /*row_idx=*/line_num - 2, svt, row_name, &nval);
-            row_names.emplace_back(row_name);
+                         /*row_idx=*/line_num - 2, svt, row_names, &nval, qc);
         } else {
             col_names = readColumnNames(line);
             ncol = col_names.size();
+            if (qc != nullptr) {
+                qc->resize(/*nrow=*/0, ncol);
+            }
         }
     }
 
+    stage.addBytesRead(bytes_read);
+    stage.addNnz(nval);
     MatrixMetadata metadata{.nrow = line_num - 1,
                             .ncol = ncol,
                             .nval = nval,
@@ -1,8 +1,9 @@
 #ifndef SMALLCOUNT_CSV_FILE_READER_H_
 #define SMALLCOUNT_CSV_FILE_READER_H_
 
-#include <fstream>
+#include <istream>
 
+#include "qc_metrics.h"
 #include "sparse_matrix.h"
 
 namespace smallcount {
@@ -10,8 +11,9 @@ namespace smallcount {
 // File reader to construct sparse matrices from .csv files.
 class CsvFileReader {
    public:
-    // Converts the contents of a .csv file into an SvtSparseMatrix.
-    static SvtSparseMatrix read(std::ifstream &file);
+    // Converts the contents of a .csv file into an SvtSparseMatrix. If `qc` is
+    // non-null, QC metrics are accumulated into it during the same pass.
+    static SvtSparseMatrix read(std::istream &file, QcMetrics *qc = nullptr);
 
    private:
     // Static class. Should not be instantiated.
@@ -0,0 +1,76 @@
+#include "csv_file_writer.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "csr_index.h"
+#include "matrix_names.h"
+#include "output_file.h"
+#include "profiler.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+namespace {
+
+// Characters (of dense rows) or names formatted per block.
+static constexpr size_t kCharsPerBlock = 1 << 20;
+static constexpr size_t kNamesPerBlock = 1 << 14;
+
+// Writes the header line: an empty top-left corner, then the barcodes.
+void writeHeader(const MatrixNames &names, OutputFile &file) {
+    const size_t size = names.barcodes.size();
+    const size_t num_blocks =
+        std::max<size_t>(1, (size + kNamesPerBlock - 1) / kNamesPerBlock);
+    file.writeBlocks(num_blocks, [&](size_t b, std::string *text) {
+        const size_t end = std::min(size, (b + 1) * kNamesPerBlock);
+        for (size_t j = b * kNamesPerBlock; j < end; j++) {
+            *text += ',';
+            text->append(names.barcodes[j]);
+        }
+        if (b + 1 == num_blocks) {
+            *text += '\n';
+        }
+    });
+}
+
+}  // namespace
+
+void CsvFileWriter::write(const SparseColumns &matrix,
+                          const MatrixNames &names, OutputFile &file) {
+    ScopedStage stage("csv");
+    checkNameCount(names.feature_ids, matrix.nrow, "feature IDs");
+    checkNameCount(names.barcodes, matrix.ncol, "barcodes");
+    countNonZeros(matrix);
+    const CsrIndex rows = rowIndex(matrix);
+
+    ScopedStage write_stage("write_rows");
+    writeHeader(names, file);
+    // Each row takes at least two characters per column.
+    const size_t row_chars = 2 * static_cast<size_t>(matrix.ncol) + 1;
+    const size_t rows_per_block =
+        std::max<size_t>(1, kCharsPerBlock / row_chars);
+    const size_t nrow = matrix.nrow;
+    const size_t num_blocks = (nrow + rows_per_block - 1) / rows_per_block;
+    file.writeBlocks(num_blocks, [&](size_t b, std::string *text) {
+        const size_t end = std::min(nrow, (b + 1) * rows_per_block);
+        text->reserve((end - b * rows_per_block) * row_chars);
+        for (size_t i = b * rows_per_block; i < end; i++) {
+            text->append(names.feature_ids[i]);
+            size_t p = rows.row_ptr[i];
+            for (int j = 0; j < matrix.ncol; j++) {
+                *text += ',';
+                if (p < rows.row_ptr[i + 1] && rows.col_ind[p] == j) {
+                    appendInteger(text, static_cast<size_t>(rows.values[p]));
+                    p++;
+                } else {
+                    *text += '0';
+                }
+            }
+            *text += '\n';
+        }
+    });
+    stage.addNnz(rows.nnz());
+}
+
+}  // namespace smallcount
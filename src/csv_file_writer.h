@@ -0,0 +1,25 @@
+#ifndef SMALLCOUNT_CSV_FILE_WRITER_H_
+#define SMALLCOUNT_CSV_FILE_WRITER_H_
+
+#include "matrix_names.h"
+#include "output_file.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+// File writer to store sparse matrices as .csv files.
+class CsvFileWriter {
+   public:
+    // Writes a matrix as a dense .csv file, with the barcodes in the header
+    // and the feature IDs in the first column (as read by CsvFileReader).
+    static void write(const SparseColumns &matrix, const MatrixNames &names,
+                      OutputFile &file);
+
+   private:
+    // Static class. Should not be instantiated.
+    CsvFileWriter() = default;
+};
+
+}  // namespace smallcount
+
+#endif
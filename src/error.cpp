@@ -0,0 +1,28 @@
+#include "error.h"
+
+#include <string>
+#include <utility>
+
+namespace smallcount {
+namespace {
+
+// Function-local so that handlers can be installed during static
+// initialization of other translation units.
+WarningHandler &warningHandler() {
+    static WarningHandler handler = [](const std::string &) {};
+    return handler;
+}
+
+}  // namespace
+
+void setWarningHandler(WarningHandler handler) {
+    warningHandler() = std::move(handler);
+}
+
+namespace internal {
+
+void emitWarning(const std::string &message) { warningHandler()(message); }
+
+}  // namespace internal
+
+}  // namespace smallcount
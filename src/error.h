@@ -0,0 +1,66 @@
+#ifndef SMALLCOUNT_ERROR_H_
+#define SMALLCOUNT_ERROR_H_
+
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+namespace smallcount {
+
+// Error raised by the core library. The Rcpp adapters let it propagate, and
+// Rcpp converts it to an R error with the same message.
+class Error : public std::runtime_error {
+   public:
+    explicit Error(const std::string &message) : std::runtime_error(message) {}
+};
+
+// Receives the warnings emitted by the core library.
+using WarningHandler = std::function<void(const std::string &)>;
+
+// Replaces the warning handler. By default, warnings are discarded (the
+// package writes nothing to stdout/stderr directly, as required by CRAN).
+void setWarningHandler(WarningHandler handler);
+
+namespace internal {
+
+// Passes strings to printf-style formatting as C strings.
+inline const char *formatArg(const std::string &arg) { return arg.c_str(); }
+template <typename T>
+T formatArg(T arg) {
+    return arg;
+}
+
+// Formats a message with printf-style arguments.
+template <typename... Args>
+std::string formatMessage(const char *format, const Args &...args) {
+    if constexpr (sizeof...(args) == 0) {
+        return format;
+    } else {
+        const int size = std::snprintf(nullptr, 0, format, formatArg(args)...);
+        std::string message(size, '\0');
+        std::snprintf(message.data(), size + 1, format, formatArg(args)...);
+        return message;
+    }
+}
+
+// Forwards a warning to the current handler.
+void emitWarning(const std::string &message);
+
+}  // namespace internal
+
+// Throws an Error with a printf-style formatted message.
+template <typename... Args>
+[[noreturn]] void fail(const char *format, const Args &...args) {
+    throw Error(internal::formatMessage(format, args...));
+}
+
+// Emits a warning with a printf-style formatted message.
+template <typename... Args>
+void warn(const char *format, const Args &...args) {
+    internal::emitWarning(internal::formatMessage(format, args...));
+}
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_ERROR_H_
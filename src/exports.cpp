@@ -1,18 +1,115 @@
+#include <algorithm>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "Rcpp.h"
+#include "error.h"
 #include "file_reader.h"
-#include "svt_apply.h"
+#include "file_writer.h"
+#include "gene_summaries.h"
+#include "group_deviance.h"
+#include "gram.h"
+#include "knn_graph.h"
+#include "matrix_names.h"
+#include "native_matrix.h"
+#include "profiler.h"
+#include "rcpp_adapters.h"
+#include "residual_matrix.h"
+#include "residuals.h"
+#include "sparse_columns.h"
+#include "sparse_sums.h"
 #include "tenx_file_params.h"
 
 using namespace Rcpp;
+using smallcount::CsrIndex;
+using smallcount::NativeMatrix;
+using smallcount::Precision;
+using smallcount::ResidualMatrix;
+using smallcount::ResidualParams;
+using smallcount::SparseColumns;
 using smallcount::Transformation;
 
-// Reads a SparseMatrix object from a file or directory.
+namespace {
+
+// Profiler activated from R, and the stages opened from R code.
+smallcount::Profiler profiler;
+std::vector<std::unique_ptr<smallcount::ScopedStage>> r_stages;
+
+// Checks that the Poisson model of a matrix has one rate per row and one
+// column sum per column.
+void checkModel(const SparseColumns &view, const NumericVector &rate,
+                const NumericVector &n) {
+    if (rate.size() != view.nrow || n.size() != view.ncol) {
+        stop("Expected %d rates and %d column sums (got %d and %d).",
+             view.nrow, view.ncol, rate.size(), n.size());
+    }
+}
+
+// Converts the R representation of a residual matrix to ResidualParams. The
+// parameters point into `rate` and `n`, which must outlive them.
+ResidualParams residualParams(const SparseColumns &view,
+                              const std::string &residual,
+                              const NumericVector &rate,
+                              const NumericVector &n, double coef = 1) {
+    ResidualParams params{.rate = rate.begin(), .n = n.begin(), .coef = coef};
+    if (!smallcount::parseResidualType(residual, &params.type)) {
+        stop("Invalid residual type: %s", residual);
+    }
+    if (smallcount::needsModel(params.type)) {
+        checkModel(view, rate, n);
+    }
+    return params;
+}
+
+// Converts 1-based groups (NA to skip a column) to the 0-based groups
+// (negative to skip) expected by the core library.
+std::vector<int> groupIndices(const SparseColumns &view,
+                              const IntegerVector &groups, int num_groups) {
+    if (groups.size() != view.ncol) {
+        stop("Expected %d groups (got %d).", view.ncol, groups.size());
+    }
+    std::vector<int> group_ind(view.ncol);
+    for (int j = 0; j < view.ncol; j++) {
+        if (groups[j] == NA_INTEGER) {
+            group_ind[j] = -1;
+        } else if (groups[j] < 1 || groups[j] > num_groups) {
+            stop("Group %d is out of range (%d groups).", groups[j],
+                 num_groups);
+        } else {
+            group_ind[j] = groups[j] - 1;
+        }
+    }
+    return group_ind;
+}
+
+// Converts the R representation of a precision to a Precision.
+Precision precisionFromString(const std::string &name) {
+    Precision precision;
+    if (!smallcount::parsePrecision(name, &precision)) {
+        stop("Invalid precision: %s", name);
+    }
+    return precision;
+}
+
+}  // namespace
+
+// Forwards the warnings of the core library to R.
+// [[Rcpp::init]]
+void installWarningHandler(DllInfo *dll) {
+    smallcount::setWarningHandler(
+        [](const std::string &message) { warning("%s", message); });
+}
+
+// Reads a SparseMatrix object, or a NativeSparseMatrix if `native` is true,
+// from a file or directory, optionally paired with QC metrics accumulated
+// while parsing.
 // [[Rcpp::export]]
 SEXP cppReadSparseMatrix(std::string sample, bool barcode_col_names,
                          bool id_row_names, std::string genome,
-                         bool use_features_tsv) {
+                         bool use_features_tsv, bool compute_qc,
+                         std::string mito_pattern, bool native) {
     smallcount::TenxFileParams file_params;
     file_params.use_barcode_col_names = barcode_col_names;
     file_params.use_id_row_names = id_row_names;
@@ -20,19 +117,279 @@ SEXP cppReadSparseMatrix(std::string sample, bool barcode_col_names,
         file_params.genome.emplace(genome);
     }
     file_params.use_features_tsv = use_features_tsv;
-    return smallcount::SparseMatrixFileReader::read(sample, file_params);
+    file_params.compute_qc = compute_qc;
+    file_params.mito_pattern = mito_pattern;
+    smallcount::ReadResult result =
+        smallcount::SparseMatrixFileReader::read(sample, file_params);
+    if (native) {
+        return smallcount::toRcppNative(std::move(result));
+    }
+    return smallcount::toRcpp(std::move(result));
+}
+
+// Writes an SVT_SparseMatrix, a dgCMatrix or a NativeSparseMatrix of counts
+// to a .csv, .csv.gz or .h5 file, or to a directory of .mtx and .tsv files.
+// [[Rcpp::export]]
+void cppWriteSparseMatrix(SEXP y, std::string sample,
+                          CharacterVector feature_ids,
+                          CharacterVector feature_names,
+                          CharacterVector barcodes, bool compress) {
+    const SparseColumns view = smallcount::columnsFromRcpp(y);
+    const smallcount::MatrixNames names{
+        .feature_ids = smallcount::namesFromRcpp(feature_ids),
+        .feature_names = smallcount::namesFromRcpp(feature_names),
+        .barcodes = smallcount::namesFromRcpp(barcodes)};
+    smallcount::SparseMatrixFileWriter::write(view, names, sample, compress);
 }
 
-// Performs `nzvals <- nzvals * log(nzvals / mu)`
+// Copies an SVT_SparseMatrix or a dgCMatrix of counts into a
+// NativeSparseMatrix with the given dimnames.
 // [[Rcpp::export]]
-List cppPoissonDevianceTransformation(List svt, NumericVector mu) {
+SEXP cppNativeSparseMatrix(SEXP y, SEXP dim_names) {
+    return smallcount::toRcpp(
+        std::make_unique<NativeMatrix>(smallcount::columnsFromRcpp(y)),
+        dim_names);
+}
+
+// Converts a NativeSparseMatrix to an SVT_SparseMatrix.
+// [[Rcpp::export]]
+SEXP cppNativeToSvt(SEXP x) {
+    return smallcount::svtFromNative(x);
+}
+
+// Builds the row index of an SVT_SparseMatrix or a dgCMatrix, to be cached on
+// the matrix by rowIndex().
+// [[Rcpp::export]]
+SEXP cppRowIndex(SEXP y) {
+    return smallcount::rowIndexFromRcpp(y);
+}
+
+// Returns the column sums of an SVT_SparseMatrix or a dgCMatrix, or the
+// cached column sums of a NativeSparseMatrix.
+// [[Rcpp::export]]
+NumericVector cppColSums(SEXP y) {
+    if (NativeMatrix *native = smallcount::nativeFromRcpp(y)) {
+        return wrap(native->colSums());
+    }
+    return wrap(smallcount::colSums(smallcount::columnsFromRcpp(y)));
+}
+
+// Returns the row sums of an SVT_SparseMatrix or a dgCMatrix, reading its
+// cached row index if it has one, or the cached row sums of a
+// NativeSparseMatrix.
+// [[Rcpp::export]]
+NumericVector cppRowSums(SEXP y) {
+    if (NativeMatrix *native = smallcount::nativeFromRcpp(y)) {
+        return wrap(native->rowSums());
+    }
+    const SparseColumns view = smallcount::columnsFromRcpp(y);
+    if (const CsrIndex *index = smallcount::cachedRowIndex(y, view)) {
+        return wrap(smallcount::rowSums(*index));
+    }
+    return wrap(smallcount::rowSums(view));
+}
+
+// Returns `rowSums(y * log(y / mu))` over the non-zero entries of `y`, where
+// `mu = rate %o% n`.
+// [[Rcpp::export]]
+NumericVector cppDevianceRowSums(SEXP y, NumericVector rate, NumericVector n) {
+    const SparseColumns view = smallcount::columnsFromRcpp(y);
+    checkModel(view, rate, n);
     Transformation dev = [](double y, double mu) { return y * log(y / mu); };
-    return smallcount::svtApply(dev, svt, mu);
+    if (const CsrIndex *index = smallcount::cachedRowIndex(y, view)) {
+        return wrap(smallcount::rowTransformSums(*index, dev, rate.begin(),
+                                                 n.begin()));
+    }
+    return wrap(smallcount::rowTransformSums(view, dev, rate.begin(),
+                                             n.begin()));
 }
 
-// Performs `nzvals <- nzvals^2 / mu`
+// Returns `rowSums(y^2 / mu)` over the non-zero entries of `y`, where
+// `mu = rate %o% n`.
 // [[Rcpp::export]]
-List cppPoissonDispersionTransformation(List svt, NumericVector mu) {
+NumericVector cppDispersionRowSums(SEXP y, NumericVector rate,
+                                   NumericVector n) {
+    const SparseColumns view = smallcount::columnsFromRcpp(y);
+    checkModel(view, rate, n);
     Transformation disp = [](double y, double mu) { return y * y / mu; };
-    return smallcount::svtApply(disp, svt, mu);
+    if (const CsrIndex *index = smallcount::cachedRowIndex(y, view)) {
+        return wrap(smallcount::rowTransformSums(*index, disp, rate.begin(),
+                                                 n.begin()));
+    }
+    return wrap(smallcount::rowTransformSums(view, disp, rate.begin(),
+                                             n.begin()));
+}
+
+// Returns the row sums of `y` within each group of columns (nrow x
+// num_groups). `groups` holds the 1-based group of each column, or NA to skip
+// the column.
+// [[Rcpp::export]]
+NumericMatrix cppGroupRowSums(SEXP y, IntegerVector groups, int num_groups) {
+    const SparseColumns view = smallcount::columnsFromRcpp(y);
+    const std::vector<int> group_ind = groupIndices(view, groups, num_groups);
+    const CsrIndex *index = smallcount::cachedRowIndex(y, view);
+    const std::vector<double> sums =
+        index != nullptr
+            ? smallcount::groupRowSums(*index, group_ind.data(), num_groups)
+            : smallcount::groupRowSums(view, group_ind.data(), num_groups);
+    NumericMatrix result(view.nrow, num_groups);
+    std::copy(sums.begin(), sums.end(), result.begin());
+    return result;
+}
+
+// Returns the per-group rates, deviance and likelihood-ratio statistics of the
+// rows of `y` (each nrow x num_groups). `groups` is as in cppGroupRowSums().
+// [[Rcpp::export]]
+List cppGroupDeviance(SEXP y, IntegerVector groups, int num_groups) {
+    const SparseColumns view = smallcount::columnsFromRcpp(y);
+    const std::vector<int> group_ind = groupIndices(view, groups, num_groups);
+    return smallcount::toRcpp(
+        smallcount::groupDeviance(view, group_ind.data(), num_groups,
+                                  smallcount::cachedRowIndex(y, view)));
+}
+
+// Returns the per-row summaries of an SVT_SparseMatrix or a dgCMatrix,
+// computed in a single pass.
+// [[Rcpp::export]]
+DataFrame cppGeneSummaries(SEXP y) {
+    return smallcount::toRcpp(
+        smallcount::geneSummaries(smallcount::columnsFromRcpp(y)));
+}
+
+// Returns the 1-based indices of the `k` largest values in decreasing order.
+// [[Rcpp::export]]
+IntegerVector cppTopK(NumericVector values, int k) {
+    if (k < 0) {
+        stop("k must be non-negative (got %d).", k);
+    }
+    std::vector<int> indices =
+        smallcount::topK(values.begin(), values.size(), k);
+    for (int &index : indices) {
+        index++;
+    }
+    return wrap(indices);
+}
+
+// Builds the graph of the `k` nearest neighbors of each row of `x`, by exact
+// search or by NN-descent.
+// [[Rcpp::export]]
+List cppKnnGraph(NumericMatrix x, int k, std::string method,
+                 int max_iterations, double sample_rate, double delta,
+                 int seed) {
+    if (method == "exact") {
+        return smallcount::toRcpp(
+            smallcount::exactKnn(x.begin(), x.nrow(), x.ncol(), k));
+    }
+    if (method != "nndescent") {
+        stop("Invalid kNN method: %s", method);
+    }
+    smallcount::NnDescentParams params;
+    params.max_iterations = max_iterations;
+    params.sample_rate = sample_rate;
+    params.delta = delta;
+    params.seed = static_cast<uint64_t>(seed);
+    return smallcount::toRcpp(
+        smallcount::nnDescentKnn(x.begin(), x.nrow(), x.ncol(), k, params));
+}
+
+// Computes the residuals of an SVT_SparseMatrix, a dgCMatrix or a
+// NativeSparseMatrix once, stored in the given precision, and returns an
+// external pointer to them that the products below accept in place of `y`
+// (with identity residuals). `coef` scales the counts of log1p residuals.
+// [[Rcpp::export]]
+SEXP cppResidualMatrix(SEXP y, std::string residual, NumericVector rate,
+                       NumericVector n, double coef, std::string precision) {
+    const SparseColumns view = smallcount::columnsFromRcpp(y);
+    return smallcount::toRcpp(std::make_unique<ResidualMatrix>(
+        view, residualParams(view, residual, rate, n, coef),
+        precisionFromString(precision)));
+}
+
+// Divides the rows of the residuals created by cppResidualMatrix() by
+// `row_scale`, or by their standard deviations if `row_scale` is empty, and
+// returns the scales used.
+// [[Rcpp::export]]
+NumericVector cppScaleResidualRows(SEXP x, NumericVector row_scale) {
+    ResidualMatrix *residuals = smallcount::residualsFromRcpp(x);
+    if (residuals == nullptr) {
+        stop("Expected an external pointer to residuals.");
+    }
+    const int nrow = residuals->columns().nrow;
+    if (row_scale.size() == 0) {
+        row_scale = wrap(residuals->rowStandardDeviations());
+    } else if (row_scale.size() != nrow) {
+        stop("Expected %d row scales (got %d).", nrow, row_scale.size());
+    }
+    residuals->scaleRows(row_scale.begin());
+    return row_scale;
+}
+
+// Computes `R %*% t(R)` for the residuals R of an SVT_SparseMatrix, a
+// dgCMatrix, a NativeSparseMatrix or residuals from cppResidualMatrix().
+// [[Rcpp::export]]
+NumericMatrix cppResidualTcrossprod(SEXP y, std::string residual,
+                                    NumericVector rate, NumericVector n,
+                                    std::string precision) {
+    const SparseColumns view = smallcount::columnsFromRcpp(y);
+    return smallcount::residualTcrossprod(
+        view, residualParams(view, residual, rate, n),
+        precisionFromString(precision));
+}
+
+// Computes `t(R) %*% v` for the residuals R of an SVT_SparseMatrix, a
+// dgCMatrix, a NativeSparseMatrix or residuals from cppResidualMatrix().
+// [[Rcpp::export]]
+NumericMatrix cppResidualCrossprod(SEXP y, std::string residual,
+                                   NumericVector rate, NumericVector n,
+                                   NumericMatrix v, std::string precision) {
+    const SparseColumns view = smallcount::columnsFromRcpp(y);
+    return smallcount::residualCrossprod(
+        view, residualParams(view, residual, rate, n), v,
+        precisionFromString(precision));
+}
+
+// Computes `R %*% v` for the residuals R of an SVT_SparseMatrix, a
+// dgCMatrix, a NativeSparseMatrix or residuals from cppResidualMatrix().
+// [[Rcpp::export]]
+NumericMatrix cppResidualProd(SEXP y, std::string residual, NumericVector rate,
+                              NumericVector n, NumericMatrix v,
+                              std::string precision) {
+    const SparseColumns view = smallcount::columnsFromRcpp(y);
+    return smallcount::residualProd(view,
+                                    residualParams(view, residual, rate, n), v,
+                                    precisionFromString(precision));
+}
+
+// Enables (clearing any previous records) or disables stage profiling.
+// [[Rcpp::export]]
+void cppSetProfiling(bool enabled) {
+    // Close leftover stages innermost first, as each one closes the innermost
+    // open peak.
+    while (!r_stages.empty()) {
+        r_stages.pop_back();
+    }
+    if (enabled) {
+        profiler = smallcount::Profiler();
+    }
+    smallcount::Profiler::setActive(enabled ? &profiler : nullptr);
+}
+
+// Opens a profiling stage for R code.
+// [[Rcpp::export]]
+void cppProfileBegin(std::string name) {
+    r_stages.emplace_back(std::make_unique<smallcount::ScopedStage>(name));
+}
+
+// Closes the innermost profiling stage opened from R.
+// [[Rcpp::export]]
+void cppProfileEnd() {
+    if (!r_stages.empty()) {
+        r_stages.pop_back();
+    }
+}
+
+// Returns the stages recorded since profiling was enabled.
+// [[Rcpp::export]]
+DataFrame cppProfileRecords() {
+    return smallcount::toRcpp(profiler.records());
 }
@@ -1,26 +1,35 @@
 #include "file_reader.h"
 
+#include <cstring>
 #include <fstream>
+#include <istream>
+#include <iterator>
 #include <memory>
+#include <optional>
+#include <sstream>
 #include <string>
 #include <unordered_set>
+#include <utility>
 
-#include "Rcpp.h"
+#include "compressed_stream.h"
 #include "csv_file_reader.h"
+#include "error.h"
 #include "hdf5.h"
 #include "hdf5_file_reader.h"
 #include "mtx_file_reader.h"
+#include "profiler.h"
+#include "qc_metrics.h"
 #include "sparse_matrix.h"
+#include "tar_reader.h"
 #include "tenx_file_params.h"
 
-using namespace Rcpp;
-
 namespace smallcount {
 namespace {
 
 static constexpr char kCsv[] = "csv";
 static constexpr char kMtx[] = "mtx";
 static constexpr char kHdf5[] = "h5";
+static constexpr char kGz[] = ".gz";
 
 const std::unordered_set<std::string> supportedExtensions = {kCsv, kMtx, kHdf5};
 
@@ -28,55 +37,281 @@ inline std::string get_extension(const std::string &filepath) {
     return filepath.substr(filepath.find_last_of(".") + 1);
 }
 
+inline bool endsWith(const std::string &filepath, const std::string &suffix) {
+    return filepath.size() >= suffix.size() &&
+           filepath.compare(filepath.size() - suffix.size(), suffix.size(),
+                            suffix) == 0;
+}
+
 std::ifstream openFile(const std::string &filepath) {
     std::ifstream file(filepath);
     if (!file.is_open()) {
-        stop("Could not open file: %s", filepath);
+        fail("Could not open file: %s", filepath);
     }
     return file;
 }
 
-SEXP readCsvFile(const std::string &filepath) {
+// Creates the QC accumulator if QC metrics were requested.
+std::optional<QcMetrics> createQcMetrics(const TenxFileParams &params) {
+    if (!params.compute_qc) {
+        return std::nullopt;
+    }
+    return QcMetrics(params.mito_pattern);
+}
+
+ReadResult readCsv(std::istream &file, const TenxFileParams &params) {
+    std::optional<QcMetrics> qc = createQcMetrics(params);
+    SvtSparseMatrix matrix =
+        CsvFileReader::read(file, qc.has_value() ? &*qc : nullptr);
+    return {std::move(matrix), std::move(qc)};
+}
+
+ReadResult readCsvFile(const std::string &filepath,
+                       const TenxFileParams &params) {
     std::ifstream file = openFile(filepath);
-    SvtSparseMatrix matrix = CsvFileReader::read(file);
+    ReadResult result = readCsv(file, params);
     file.close();
+    return result;
+}
 
-    return matrix.toRcpp();
+ReadResult readMtx(std::istream &matrix_file, std::istream &barcodes_file,
+                   std::istream &features_file, const TenxFileParams &params) {
+    std::optional<QcMetrics> qc = createQcMetrics(params);
+    SvtSparseMatrix matrix =
+        MtxFileReader::read(matrix_file, barcodes_file, features_file, params,
+                            qc.has_value() ? &*qc : nullptr);
+    return {std::move(matrix), std::move(qc)};
 }
 
-SEXP readMtxFile(const std::string &filedir, const TenxFileParams &params) {
+ReadResult readMtxFile(const std::string &filedir,
+                       const TenxFileParams &params) {
     std::ifstream matrix_file = openFile(filedir + "matrix.mtx");
     std::ifstream barcodes_file = openFile(filedir + "barcodes.tsv");
     const std::string features_filename =
         params.use_features_tsv ? "features.tsv" : "genes.tsv";
     std::ifstream features_file = openFile(filedir + features_filename);
-    SvtSparseMatrix matrix =
-        MtxFileReader::read(matrix_file, barcodes_file, features_file, params);
+    ReadResult result =
+        readMtx(matrix_file, barcodes_file, features_file, params);
     matrix_file.close();
     barcodes_file.close();
     features_file.close();
+    return result;
+}
 
-    return matrix.toRcpp();
+// Reads an open HDF5 file, then closes it.
+ReadResult readHdf5(hid_t file, const TenxFileParams &params) {
+    std::optional<QcMetrics> qc = createQcMetrics(params);
+    SvtSparseMatrix matrix =
+        Hdf5FileReader::read(file, params, qc.has_value() ? &*qc : nullptr);
+    H5Fclose(file);
+    return {std::move(matrix), std::move(qc)};
 }
 
-SEXP readHdf5File(const std::string &filepath, const TenxFileParams &params) {
+ReadResult readHdf5File(const std::string &filepath,
+                        const TenxFileParams &params) {
     hid_t file = H5Fopen(filepath.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
     if (file < 0) {
-        stop("Could not open file: %s", filepath);
+        fail("Could not open file: %s", filepath);
     }
-    SvtSparseMatrix matrix = Hdf5FileReader::read(file, params);
-    H5Fclose(file);
+    return readHdf5(file, params);
+}
 
-    return matrix.toRcpp();
+// Reads an HDF5 file from its contents in memory (a "file image"), through
+// the core (in-memory) driver of the HDF5 library.
+ReadResult readHdf5Image(const std::string &image, const std::string &name,
+                         const TenxFileParams &params) {
+    hid_t access = H5Pcreate(H5P_FILE_ACCESS);
+    H5Pset_fapl_core(access, /*increment=*/image.size(),
+                     /*backing_store=*/false);
+    H5Pset_file_image(access, const_cast<char *>(image.data()), image.size());
+    hid_t file = H5Fopen(name.c_str(), H5F_ACC_RDONLY, access);
+    H5Pclose(access);
+    if (file < 0) {
+        fail("Could not open HDF5 file from archive: %s", name);
+    }
+    return readHdf5(file, params);
+}
+
+// Files that the readers take from a tarball.
+enum class ArchiveFile {
+    kMatrix,
+    kBarcodes,
+    kFeatures,
+    kGenes,
+    kCsv,
+    kHdf5,
+    kOther
+};
+
+// Path of a file in a tarball.
+struct ArchivePath {
+    std::string dir;  // Directory within the archive
+    ArchiveFile file;
+    bool gzip;  // Whether the file is gzipped (e.g., matrix.mtx.gz)
+};
+
+ArchivePath parseArchivePath(const std::string &path) {
+    const size_t separator = path.find_last_of('/');
+    ArchivePath result;
+    result.dir =
+        separator == std::string::npos ? "" : path.substr(0, separator);
+    std::string name =
+        separator == std::string::npos ? path : path.substr(separator + 1);
+    result.gzip = endsWith(name, kGz);
+    if (result.gzip) {
+        name.resize(name.size() - strlen(kGz));
+    }
+    // Skip the resource forks that macOS adds to archives (e.g.,
+    // "._matrix.mtx").
+    if (name.rfind("._", 0) == 0) {
+        result.file = ArchiveFile::kOther;
+    } else if (endsWith(name, "matrix.mtx")) {
+        result.file = ArchiveFile::kMatrix;
+    } else if (endsWith(name, "barcodes.tsv")) {
+        result.file = ArchiveFile::kBarcodes;
+    } else if (endsWith(name, "features.tsv")) {
+        result.file = ArchiveFile::kFeatures;
+    } else if (endsWith(name, "genes.tsv")) {
+        result.file = ArchiveFile::kGenes;
+    } else if (endsWith(name, std::string(".") + kCsv)) {
+        result.file = ArchiveFile::kCsv;
+    } else if (endsWith(name, std::string(".") + kHdf5)) {
+        result.file = ArchiveFile::kHdf5;
+    } else {
+        result.file = ArchiveFile::kOther;
+    }
+    return result;
+}
+
+// Stream of the contents of the current file of a tarball, decompressed if
+// the file is gzipped.
+class ArchiveFileStream {
+   public:
+    ArchiveFileStream(TarReader &tar, bool gzip)
+        : decompressed(gzip ? std::make_unique<DecompressingStreamBuf>(
+                                  tar.contents().rdbuf(), Compression::kGzip)
+                            : nullptr),
+          stream(gzip ? decompressed.get() : tar.contents().rdbuf()) {
+        stream.exceptions(std::ios::badbit);
+    }
+
+    std::istream &get() { return stream; }
+
+    // Reads the rest of the file into memory.
+    std::string readAll() {
+        return std::string(std::istreambuf_iterator<char>(stream),
+                           std::istreambuf_iterator<char>());
+    }
+
+   private:
+    std::unique_ptr<DecompressingStreamBuf> decompressed;
+    std::istream stream;
+};
+
+// Reads the matrix of a tarball of a CellRanger output directory, a .csv file
+// or an .h5 file, streaming each file out of the archive. The files of a
+// CellRanger directory are read from the directory of the first one found.
+// The barcodes and features are held in memory until the matrix is found,
+// which is then parsed as it is decompressed. The matrix is held in memory
+// too if it precedes them in the archive, or if only genes.tsv precedes it,
+// since a features.tsv (which takes precedence) may follow.
+ReadResult readTarballFiles(TarReader &tar, const std::string &filepath,
+                            const TenxFileParams &params) {
+    std::optional<std::string> dir;
+    std::optional<std::string> matrix;
+    std::optional<std::string> barcodes;
+    std::optional<std::string> features;
+    bool features_tsv = false;
+    while (tar.next()) {
+        const ArchivePath path = parseArchivePath(tar.path());
+        if (path.file == ArchiveFile::kOther) {
+            continue;
+        }
+        ArchiveFileStream stream(tar, path.gzip);
+        if (path.file == ArchiveFile::kCsv) {
+            return readCsv(stream.get(), params);
+        } else if (path.file == ArchiveFile::kHdf5) {
+            // Names the image after its path within the tarball, which cannot
+            // exist on disk and be mistaken for the image by the library.
+            return readHdf5Image(stream.readAll(), filepath + "/" + tar.path(),
+                                 params);
+        }
+        if (!dir.has_value()) {
+            dir = path.dir;
+        } else if (*dir != path.dir) {
+            continue;
+        }
+        if (path.file == ArchiveFile::kMatrix) {
+            if (barcodes.has_value() && features_tsv) {
+                std::istringstream barcodes_file(*barcodes);
+                std::istringstream features_file(*features);
+                return readMtx(stream.get(), barcodes_file, features_file,
+                               params);
+            }
+            matrix = stream.readAll();
+        } else if (path.file == ArchiveFile::kBarcodes) {
+            barcodes = stream.readAll();
+        } else if (path.file == ArchiveFile::kFeatures) {
+            features = stream.readAll();
+            features_tsv = true;
+        } else if (path.file == ArchiveFile::kGenes && !features_tsv) {
+            features = stream.readAll();
+        }
+        if (matrix.has_value() && barcodes.has_value() && features_tsv) {
+            break;
+        }
+    }
+    if (matrix.has_value() && barcodes.has_value() && features.has_value()) {
+        std::istringstream matrix_file(*matrix);
+        std::istringstream barcodes_file(*barcodes);
+        std::istringstream features_file(*features);
+        return readMtx(matrix_file, barcodes_file, features_file, params);
+    }
+    fail(
+        "Invalid archive. No matrix.mtx, barcodes.tsv and features.tsv (or "
+        "genes.tsv), .csv or .h5 file found in %s",
+        filepath);
+}
+
+// Compression of a tarball, or nullopt if the file is not a tarball.
+std::optional<Compression> tarballCompression(const std::string &filepath) {
+    if (endsWith(filepath, ".tar")) {
+        return Compression::kNone;
+    } else if (endsWith(filepath, ".tgz") || endsWith(filepath, ".tar.gz")) {
+        return Compression::kGzip;
+    } else if (endsWith(filepath, ".tbz2") ||
+               endsWith(filepath, ".tar.bz2")) {
+        return Compression::kBzip2;
+    }
+    return std::nullopt;
+}
+
+ReadResult readTarball(const std::string &filepath, Compression compression,
+                       const TenxFileParams &params) {
+    ScopedStage stage("tar");
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file.is_open()) {
+        fail("Could not open file: %s", filepath);
+    }
+    DecompressingStreamBuf decompressed(file.rdbuf(), compression);
+    TarReader tar(&decompressed);
+    ReadResult result = readTarballFiles(tar, filepath, params);
+    stage.addBytesRead(decompressed.bytesRead());
+    return result;
 }
 
 }  // namespace
 
-SEXP SparseMatrixFileReader::read(const std::string &filepath,
-                                  const TenxFileParams &params) {
+ReadResult SparseMatrixFileReader::read(const std::string &filepath,
+                                        const TenxFileParams &params) {
+    ScopedStage stage("read");
+    const std::optional<Compression> tarball = tarballCompression(filepath);
+    if (tarball.has_value()) {
+        return readTarball(filepath, *tarball, params);
+    }
     const std::string file_extension = get_extension(filepath);
     if (file_extension == kCsv) {
-        return readCsvFile(filepath);
+        return readCsvFile(filepath, params);
     } else if (file_extension == kHdf5) {
         return readHdf5File(filepath, params);
     }
@@ -1,21 +1,29 @@
 #ifndef SMALLCOUNT_FILE_READER_H_
 #define SMALLCOUNT_FILE_READER_H_
 
+#include <optional>
 #include <string>
 
-#include "Rcpp.h"
+#include "qc_metrics.h"
+#include "sparse_matrix.h"
 #include "tenx_file_params.h"
 
-using namespace Rcpp;
-
 namespace smallcount {
 
+// Sparse matrix read from a file, with the QC metrics accumulated while
+// parsing (if requested).
+struct ReadResult {
+    SvtSparseMatrix matrix;
+    std::optional<QcMetrics> qc;
+};
+
 // Static class to parse SparseMatrix objects.
 class SparseMatrixFileReader {
    public:
     // Reads a sparse matrix from a file or directory, returning an SVT
     // representation.
-    static SEXP read(const std::string &filepath, const TenxFileParams &params);
+    static ReadResult read(const std::string &filepath,
+                           const TenxFileParams &params);
 };
 
 }  // namespace smallcount
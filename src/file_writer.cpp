@@ -0,0 +1,83 @@
+#include "file_writer.h"
+
+#include <string>
+
+#include "csv_file_writer.h"
+#include "error.h"
+#include "hdf5.h"
+#include "hdf5_file_writer.h"
+#include "matrix_names.h"
+#include "mtx_file_writer.h"
+#include "output_file.h"
+#include "profiler.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+namespace {
+
+static constexpr char kCsv[] = ".csv";
+static constexpr char kCsvGz[] = ".csv.gz";
+static constexpr char kHdf5[] = ".h5";
+static constexpr char kGz[] = ".gz";
+
+inline bool endsWith(const std::string &filepath, const std::string &suffix) {
+    return filepath.size() >= suffix.size() &&
+           filepath.compare(filepath.size() - suffix.size(), suffix.size(),
+                            suffix) == 0;
+}
+
+void writeCsvFile(const SparseColumns &matrix, const MatrixNames &names,
+                  const std::string &filepath, bool gzip) {
+    OutputFile file(filepath, gzip);
+    CsvFileWriter::write(matrix, names, file);
+    file.close();
+}
+
+void writeMtxFile(const SparseColumns &matrix, const MatrixNames &names,
+                  const std::string &filedir, bool gzip) {
+    const std::string suffix = gzip ? kGz : "";
+    OutputFile matrix_file(filedir + "matrix.mtx" + suffix, gzip);
+    OutputFile barcodes_file(filedir + "barcodes.tsv" + suffix, gzip);
+    OutputFile features_file(filedir + "features.tsv" + suffix, gzip);
+    MtxFileWriter::write(matrix, names, matrix_file, barcodes_file,
+                         features_file);
+    matrix_file.close();
+    barcodes_file.close();
+    features_file.close();
+}
+
+void writeHdf5File(const SparseColumns &matrix, const MatrixNames &names,
+                   const std::string &filepath, bool compress) {
+    hid_t file =
+        H5Fcreate(filepath.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (file < 0) {
+        fail("Could not create file: %s", filepath);
+    }
+    try {
+        Hdf5FileWriter::write(matrix, names, file, compress);
+    } catch (...) {
+        H5Fclose(file);
+        throw;
+    }
+    H5Fclose(file);
+}
+
+}  // namespace
+
+void SparseMatrixFileWriter::write(const SparseColumns &matrix,
+                                   const MatrixNames &names,
+                                   const std::string &filepath,
+                                   bool compress) {
+    ScopedStage stage("write");
+    if (endsWith(filepath, kCsv)) {
+        writeCsvFile(matrix, names, filepath, /*gzip=*/false);
+    } else if (endsWith(filepath, kCsvGz)) {
+        writeCsvFile(matrix, names, filepath, /*gzip=*/true);
+    } else if (endsWith(filepath, kHdf5)) {
+        writeHdf5File(matrix, names, filepath, compress);
+    } else {
+        writeMtxFile(matrix, names, filepath, compress);
+    }
+}
+
+}  // namespace smallcount
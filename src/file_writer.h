@@ -0,0 +1,25 @@
+#ifndef SMALLCOUNT_FILE_WRITER_H_
+#define SMALLCOUNT_FILE_WRITER_H_
+
+#include <string>
+
+#include "matrix_names.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+// Static class to write sparse matrices to files.
+class SparseMatrixFileWriter {
+   public:
+    // Writes a matrix of counts to a .csv (or .csv.gz) file, an .h5 file, or
+    // a directory of .mtx and .tsv files (if `filepath` ends with a path
+    // separator), in the formats read by SparseMatrixFileReader. `compress`
+    // gzips the files of a directory and deflates the datasets of an .h5
+    // file.
+    static void write(const SparseColumns &matrix, const MatrixNames &names,
+                      const std::string &filepath, bool compress);
+};
+
+}  // namespace smallcount
+
+#endif
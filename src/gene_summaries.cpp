@@ -0,0 +1,91 @@
+#include "gene_summaries.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#include "profiler.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+GeneSummaries geneSummaries(const SparseColumns &view) {
+    ScopedStage stage("gene_summaries");
+    stage.addNnz(view.nnz());
+    const int nrow = view.nrow;
+    const int ncol = view.ncol;
+
+    // Accumulators of the single pass (see the header).
+    GeneSummaries summaries;
+    summaries.sum.assign(nrow, 0);
+    summaries.detected.assign(nrow, 0);
+    std::vector<double> sum_squares(nrow, 0);
+    std::vector<double> y_log_y(nrow, 0);
+    std::vector<double> y_log_n(nrow, 0);
+    std::vector<double> y2_over_n(nrow, 0);
+    double total = 0;
+
+    for (const SparseColumn &column : view.columns) {
+        double n = 0;
+        column.forEach([&](int, double y) { n += y; });
+        if (n == 0) {
+            continue;
+        }
+        total += n;
+        const double log_n = std::log(n);
+        column.forEach([&](int row, double y) {
+            summaries.sum[row] += y;
+            summaries.detected[row]++;
+            sum_squares[row] += y * y;
+            y_log_y[row] += y * std::log(y);
+            y_log_n[row] += y * log_n;
+            y2_over_n[row] += y * y / n;
+        });
+    }
+
+    summaries.mean.resize(nrow);
+    summaries.variance.resize(nrow);
+    summaries.deviance.resize(nrow);
+    summaries.dispersion.resize(nrow);
+    for (int i = 0; i < nrow; i++) {
+        const double sum = summaries.sum[i];
+        summaries.mean[i] = sum / ncol;
+        summaries.variance[i] =
+            (sum_squares[i] - sum * sum / ncol) / (ncol - 1);
+        if (sum == 0) {
+            // No non-zero entries contribute to the deviance or dispersion.
+            summaries.deviance[i] = 0;
+            summaries.dispersion[i] = 0;
+            continue;
+        }
+        const double rate = sum / total;
+        summaries.deviance[i] =
+            2 * (y_log_y[i] - y_log_n[i] - sum * std::log(rate));
+        summaries.dispersion[i] =
+            (y2_over_n[i] / rate - total * rate) / (ncol - 1);
+    }
+    return summaries;
+}
+
+std::vector<int> topK(const double *values, size_t size, size_t k) {
+    std::vector<int> indices(size);
+    std::iota(indices.begin(), indices.end(), 0);
+    k = std::min(k, size);
+    // Decreasing order, NaN last and ties broken by index.
+    const auto before = [values](int a, int b) {
+        if (std::isnan(values[b])) {
+            return !std::isnan(values[a]) || a < b;
+        }
+        if (std::isnan(values[a])) {
+            return false;
+        }
+        return values[a] > values[b] || (values[a] == values[b] && a < b);
+    };
+    std::partial_sort(indices.begin(), indices.begin() + k, indices.end(),
+                      before);
+    indices.resize(k);
+    return indices;
+}
+
+}  // namespace smallcount
@@ -0,0 +1,42 @@
+#ifndef SMALLCOUNT_GENE_SUMMARIES_H_
+#define SMALLCOUNT_GENE_SUMMARIES_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+// Per-row statistics of a count matrix used for feature selection. The
+// deviance and dispersion are those of the Poisson model with row-wise rates
+// `rowSums(y) / sum(y)` and column totals `colSums(y)` (see poissonDeviance()
+// and poissonDispersion()).
+struct GeneSummaries {
+    std::vector<double> sum;         // Total count
+    std::vector<double> mean;        // Mean count
+    std::vector<double> variance;    // Sample variance of the counts
+    std::vector<int> detected;       // Number of non-zero columns
+    std::vector<double> deviance;    // Poisson deviance
+    std::vector<double> dispersion;  // Poisson dispersion
+};
+
+// Computes all the summaries in a single pass over the non-zero entries.
+//
+// The model depends on the column totals, which are only known after a full
+// pass, so the pass accumulates terms from which the model is factored out:
+// for a row with total s and rate r = s / sum(n),
+//   sum(y * log(y / (r * n))) = sum(y * log(y)) - sum(y * log(n)) - s * log(r)
+//   sum(y^2 / (r * n)) = sum(y^2 / n) / r
+// where each column's total n is computed just before its entries are
+// visited, while the column is still in cache.
+GeneSummaries geneSummaries(const SparseColumns &view);
+
+// Returns the 0-based indices of the (at most) k largest values in decreasing
+// order, selected with a partial sort. NaN values are never selected before
+// numbers.
+std::vector<int> topK(const double *values, size_t size, size_t k);
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_GENE_SUMMARIES_H_
@@ -0,0 +1,105 @@
+#include "gram.h"
+
+#include <cstdint>
+#include <string>
+
+#include "parallel.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+bool parsePrecision(const std::string &name, Precision *precision) {
+    if (name == "double") {
+        *precision = Precision::kDouble;
+    } else if (name == "float") {
+        *precision = Precision::kFloat;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void tcrossprod(const SparseColumns &view, double *out) {
+    const int nrow = view.nrow;
+
+    // Each thread owns the Gram columns of the rows congruent to its index, so
+    // the upper triangle can be accumulated without synchronization. Rows are
+    // sorted within each column, so q <= p implies rows[q] <= rows[p].
+#pragma omp parallel
+    {
+        const int num_threads = threadCount();
+        const int thread = threadIndex();
+        for (const SparseColumn &column : view.columns) {
+            const int *rows = column.rows;
+            column.withValues([&](auto value) {
+                for (size_t p = 0; p < column.nnz; p++) {
+                    if (rows[p] % num_threads != thread) {
+                        continue;
+                    }
+                    const double val_p = value(p);
+                    double *gram_col =
+                        out + static_cast<size_t>(rows[p]) * nrow;
+                    for (size_t q = 0; q <= p; q++) {
+                        gram_col[rows[q]] += val_p * value(q);
+                    }
+                }
+            });
+        }
+    }
+
+    // Mirror the upper triangle.
+    for (int j = 0; j < nrow; j++) {
+        for (int i = 0; i < j; i++) {
+            out[j + static_cast<size_t>(i) * nrow] =
+                out[i + static_cast<size_t>(j) * nrow];
+        }
+    }
+}
+
+void crossprod(const SparseColumns &view, const double *v, int k,
+               double *out) {
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < view.ncol; i++) {
+        const SparseColumn &column = view.columns[i];
+        column.withValues([&](auto value) {
+            for (int j = 0; j < k; j++) {
+                const double *v_col = v + static_cast<size_t>(j) * view.nrow;
+                double sum = 0;
+                for (size_t p = 0; p < column.nnz; p++) {
+                    sum += value(p) * v_col[column.rows[p]];
+                }
+                out[i + static_cast<size_t>(j) * view.ncol] = sum;
+            }
+        });
+    }
+}
+
+void prod(const SparseColumns &view, const double *v, int k, double *out) {
+    const int nrow = view.nrow;
+    const int ncol = view.ncol;
+
+    // Each thread owns a contiguous range of output rows, so the result is
+    // accumulated without synchronization (and in the same order for any
+    // number of threads). Rows are sorted within each column, so each thread
+    // finds the start of its range in a column by binary search.
+#pragma omp parallel
+    {
+        const int num_threads = threadCount();
+        const int thread = threadIndex();
+        const int row_begin =
+            static_cast<int64_t>(nrow) * thread / num_threads;
+        const int row_end =
+            static_cast<int64_t>(nrow) * (thread + 1) / num_threads;
+        for (int i = 0; row_begin < row_end && i < ncol; i++) {
+            view.columns[i].forEachInRows(
+                row_begin, row_end, [&](int row, double value) {
+                    for (int j = 0; j < k; j++) {
+                        out[row + static_cast<size_t>(j) * nrow] +=
+                            value * v[i + static_cast<size_t>(j) * ncol];
+                    }
+                });
+        }
+    }
+}
+
+}  // namespace smallcount
@@ -0,0 +1,35 @@
+#ifndef SMALLCOUNT_GRAM_H_
+#define SMALLCOUNT_GRAM_H_
+
+#include <string>
+
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+// Precision used to store the residuals while a product is computed. Products
+// are always accumulated in double precision.
+enum class Precision { kDouble, kFloat };
+
+// Parses a precision from its R name ("double" or "float"). Returns false if
+// the name is not recognized.
+bool parsePrecision(const std::string &name, Precision *precision);
+
+// The products below read the values of a sparse matrix view R (e.g., the
+// counts of an SVT, or residuals stored as float or double) and write
+// column-major results into `out`, which must be zero-initialized. `v` is a
+// column-major matrix with k columns.
+
+// Computes `R %*% t(R)` (nrow x nrow).
+void tcrossprod(const SparseColumns &view, double *out);
+
+// Computes `t(R) %*% v` (ncol x k) for an nrow x k matrix v.
+void crossprod(const SparseColumns &view, const double *v, int k,
+               double *out);
+
+// Computes `R %*% v` (nrow x k) for an ncol x k matrix v.
+void prod(const SparseColumns &view, const double *v, int k, double *out);
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_GRAM_H_
@@ -0,0 +1,123 @@
+#include "group_deviance.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "csr_index.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+namespace {
+
+// Returns `s * log(s / (t * r))`, the contribution of a count total `s` over
+// a column total `t` to a log-likelihood ratio against rate `r` (zero if
+// `s` is zero).
+double xLogRatio(double s, double t, double r) {
+    return s == 0 ? 0 : s * std::log(s / (t * r));
+}
+
+// Statistics of row i. On entry, `rates` holds sum(y) and `deviance` holds
+// sum(y * log(y / n)) of each (row, group), which are replaced in place.
+void finishRow(int i, const std::vector<double> &totals, double total,
+               GroupDeviance *result) {
+    const int nrow = result->nrow;
+    double row_sum = 0;
+    for (int g = 0; g < result->num_groups; g++) {
+        row_sum += result->rates[i + static_cast<size_t>(g) * nrow];
+    }
+    if (row_sum == 0) {
+        return;
+    }
+    const double rate = row_sum / total;
+    for (int g = 0; g < result->num_groups; g++) {
+        const size_t k = i + static_cast<size_t>(g) * nrow;
+        const double s = result->rates[k];
+        const double t = totals[g];
+        if (s > 0) {
+            const double group_rate = s / t;
+            result->rates[k] = group_rate;
+            result->deviance[k] =
+                2 * (result->deviance[k] - s * std::log(group_rate));
+        }
+        result->lrt[k] = 2 * (xLogRatio(s, t, rate) +
+                              xLogRatio(row_sum - s, total - t, rate));
+    }
+}
+
+}  // namespace
+
+GroupDeviance groupDeviance(const SparseColumns &view, const int *groups,
+                            int num_groups, const CsrIndex *index) {
+    ScopedStage stage("group_deviance");
+    stage.addNnz(view.nnz());
+    const int nrow = view.nrow;
+    const int ncol = view.ncol;
+
+    // Column totals, and the total count of each group.
+    std::vector<double> n(ncol, 0);
+    std::vector<double> log_n(ncol, 0);
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int j = 0; j < ncol; j++) {
+        double sum = 0;
+        view.columns[j].forEach([&](int, double y) { sum += y; });
+        n[j] = sum;
+        log_n[j] = sum == 0 ? 0 : std::log(sum);
+    }
+    std::vector<double> totals(num_groups, 0);
+    double total = 0;
+    for (int j = 0; j < ncol; j++) {
+        if (groups[j] >= 0) {
+            totals[groups[j]] += n[j];
+            total += n[j];
+        }
+    }
+
+    GroupDeviance result;
+    result.nrow = nrow;
+    result.num_groups = num_groups;
+    result.rates.assign(static_cast<size_t>(nrow) * num_groups, 0);
+    result.deviance.assign(result.rates.size(), 0);
+    result.lrt.assign(result.rates.size(), 0);
+    const auto accumulate = [&](int row, int col, double y) {
+        if (groups[col] < 0 || n[col] == 0) {
+            return;
+        }
+        const size_t k = row + static_cast<size_t>(groups[col]) * nrow;
+        result.rates[k] += y;
+        result.deviance[k] += y * (std::log(y) - log_n[col]);
+    };
+
+    if (index != nullptr) {
+#pragma omp parallel for schedule(dynamic, 64)
+        for (int i = 0; i < nrow; i++) {
+            index->forEachInRow(
+                i, [&](int col, double y) { accumulate(i, col, y); });
+            finishRow(i, totals, total, &result);
+        }
+        return result;
+    }
+
+#pragma omp parallel
+    {
+        const int num_threads = threadCount();
+        const int thread = threadIndex();
+        const int row_begin =
+            static_cast<int64_t>(nrow) * thread / num_threads;
+        const int row_end =
+            static_cast<int64_t>(nrow) * (thread + 1) / num_threads;
+        for (int j = 0; row_begin < row_end && j < ncol; j++) {
+            view.columns[j].forEachInRows(
+                row_begin, row_end,
+                [&](int row, double y) { accumulate(row, j, y); });
+        }
+        for (int i = row_begin; i < row_end; i++) {
+            finishRow(i, totals, total, &result);
+        }
+    }
+    return result;
+}
+
+}  // namespace smallcount
@@ -0,0 +1,43 @@
+#ifndef SMALLCOUNT_GROUP_DEVIANCE_H_
+#define SMALLCOUNT_GROUP_DEVIANCE_H_
+
+#include <vector>
+
+#include "csr_index.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+// Per-row, per-group statistics of the Poisson model `mu = rate * n` fitted
+// separately within each group of columns. Each matrix is nrow x num_groups,
+// column-major.
+struct GroupDeviance {
+    int nrow = 0;
+    int num_groups = 0;
+    // Rate of each row within each group (row sum / group total).
+    std::vector<double> rates;
+    // Deviance of each row within each group under the group's rates.
+    std::vector<double> deviance;
+    // Likelihood-ratio statistic of each row for a separate rate in each group
+    // against a common rate, with the rest of the columns sharing one rate.
+    std::vector<double> lrt;
+};
+
+// Computes the statistics of each group in a single parallel pass over the
+// non-zero entries. `groups` holds the 0-based group of each column; columns
+// with a negative group are skipped. Rows are read from `index` if it is
+// non-null; otherwise, each thread reads the entries of a contiguous range of
+// rows from the columns. Either way, each thread owns the results of its rows,
+// so no per-thread copies of the nrow x num_groups terms are needed.
+//
+// As in geneSummaries(), the deviance of a row with total s and rate r within
+// a group is accumulated as
+//   2 * (sum(y * log(y)) - sum(y * log(n)) - s * log(r)),
+// and the likelihood ratio only depends on the group and row totals:
+//   2 * (s_g * log(r_g / r) + s_rest * log(r_rest / r)).
+GroupDeviance groupDeviance(const SparseColumns &view, const int *groups,
+                            int num_groups, const CsrIndex *index = nullptr);
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_GROUP_DEVIANCE_H_
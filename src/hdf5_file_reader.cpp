@@ -1,16 +1,18 @@
 #include "hdf5_file_reader.h"
 
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 
-#include "Rcpp.h"
+#include "error.h"
 #include "hdf5.h"
+#include "name_table.h"
+#include "profiler.h"
+#include "qc_metrics.h"
 #include "sparse_matrix.h"
 #include "tenx_file_params.h"
 
-using namespace Rcpp;
-
 namespace smallcount {
 namespace {
 
@@ -39,17 +41,21 @@ std::string shapeDataset(const TenxFileParams &params) {
     return h5GroupName(params) + "/shape";
 }
 
-// Name of the HDF5 dataset storing the row names.
-std::string featuresDataset(const TenxFileParams &params) {
+// Name of the HDF5 dataset storing the feature IDs or symbols.
+std::string featuresDataset(const TenxFileParams &params, bool use_ids) {
     if (params.genome.has_value()) {
-        std::string dataset =
-            params.use_id_row_names ? "/genes" : "/gene_names";
+        std::string dataset = use_ids ? "/genes" : "/gene_names";
         return h5GroupName(params) + dataset;
     }
-    std::string dataset = params.use_id_row_names ? "/id" : "/name";
+    std::string dataset = use_ids ? "/id" : "/name";
     return h5GroupName(params) + "/features" + dataset;
 }
 
+// Name of the HDF5 dataset storing the row names.
+std::string featuresDataset(const TenxFileParams &params) {
+    return featuresDataset(params, params.use_id_row_names);
+}
+
 // Name of the HDF5 dataset storing the column names.
 std::string barcodesDataset(const TenxFileParams &params) {
     return h5GroupName(params) + "/barcodes";
@@ -72,52 +78,104 @@ std::vector<uint64_t> readData<uint64_t>(hid_t dataset, hsize_t num_entries) {
             data.data());
     return data;
 }
-template <>
-std::vector<std::string> readData<std::string>(hid_t dataset,
-                                               hsize_t num_entries) {
-    hid_t data_type = H5Dget_type(dataset);
-    size_t str_size = H5Tget_size(data_type) + 1;
 
+// Reads a dataset of variable-length strings, copying each string into the
+// arena of the returned names.
+NameTable readVariableLengthNames(hid_t dataset, hid_t data_type,
+                                  hsize_t num_entries) {
+    hid_t mem_type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(mem_type, H5T_VARIABLE);
+    H5Tset_cset(mem_type, H5Tget_cset(data_type));
+
+    std::vector<char *> buffer(num_entries, nullptr);
+    H5Dread(dataset, mem_type, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.data());
+    NameTable names;
+    for (const char *str : buffer) {
+        names.append(str == nullptr ? "" : str);
+    }
+
+    hid_t dataspace = H5Dget_space(dataset);
+    H5Dvlen_reclaim(mem_type, dataspace, H5P_DEFAULT, buffer.data());
+    H5Sclose(dataspace);
+    H5Tclose(mem_type);
+    return names;
+}
+
+// Reads a dataset of fixed-length strings. The padded read buffer serves as
+// the arena of the returned names, so each string is copied only once.
+NameTable readFixedLengthNames(hid_t dataset, hid_t data_type,
+                               hsize_t num_entries) {
+    const size_t str_size = H5Tget_size(data_type);
     hid_t mem_type = H5Tcopy(H5T_C_S1);
     H5Tset_size(mem_type, str_size);
+    H5Tset_strpad(mem_type, H5T_STR_NULLPAD);
+    H5Tset_cset(mem_type, H5Tget_cset(data_type));
 
-    char *buffer = new char[num_entries * str_size];
-    H5Dread(dataset, mem_type, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer);
-    std::vector<std::string> data(num_entries);
+    std::string buffer(num_entries * str_size, '\0');
+    H5Dread(dataset, mem_type, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.data());
+    std::vector<NameTable::Span> spans(num_entries);
     for (size_t i = 0; i < num_entries; i++) {
-        std::string str(buffer + i * str_size, str_size);
-        str.erase(str.find('\0'));
-        data[i] = str;
+        const size_t offset = i * str_size;
+        spans[i] = {offset, strnlen(buffer.data() + offset, str_size)};
     }
 
-    delete[] buffer;
     H5Tclose(mem_type);
+    return NameTable(std::move(buffer), std::move(spans));
+}
+
+// Reads a dataset of fixed- or variable-length strings.
+NameTable readNames(hid_t dataset, hsize_t num_entries) {
+    hid_t data_type = H5Dget_type(dataset);
+    NameTable names =
+        H5Tis_variable_str(data_type) > 0
+            ? readVariableLengthNames(dataset, data_type, num_entries)
+            : readFixedLengthNames(dataset, data_type, num_entries);
     H5Tclose(data_type);
-    return data;
+    return names;
 }
 
 // Reads the contents of an HDF5 dataset into a vector of type T.
 template <typename T>
 std::vector<T> readDataset(hid_t file, const std::string &dataset_name) {
+    ScopedStage stage("read_dataset");
     hid_t dataset = H5Dopen2(file, dataset_name.c_str(), H5P_DEFAULT);
     hid_t dataspace = H5Dget_space(dataset);
 
     hsize_t num_entries;
     H5Sget_simple_extent_dims(dataspace, &num_entries, NULL);
     std::vector<T> data = readData<T>(dataset, num_entries);
+    stage.addBytesRead(num_entries * sizeof(T));
 
     H5Sclose(dataspace);
     H5Dclose(dataset);
     return data;
 }
 
+// Reads the contents of an HDF5 string dataset into a NameTable.
+NameTable readNamesDataset(hid_t file, const std::string &dataset_name) {
+    ScopedStage stage("read_names");
+    hid_t dataset = H5Dopen2(file, dataset_name.c_str(), H5P_DEFAULT);
+    hid_t dataspace = H5Dget_space(dataset);
+
+    hsize_t num_entries;
+    H5Sget_simple_extent_dims(dataspace, &num_entries, NULL);
+    NameTable names = readNames(dataset, num_entries);
+    stage.addBytesRead(names.bytes());
+
+    H5Sclose(dataspace);
+    H5Dclose(dataset);
+    return names;
+}
+
 }  // namespace
 
-SvtSparseMatrix Hdf5FileReader::read(hid_t file, const TenxFileParams &params) {
+SvtSparseMatrix Hdf5FileReader::read(hid_t file, const TenxFileParams &params,
+                                     QcMetrics *qc) {
+    ScopedStage stage("hdf5");
     // Check if HDF5 group exists.
     const std::string genome = h5GroupName(params);
     if (H5Lexists(file, genome.c_str(), H5P_DEFAULT) <= 0) {
-        stop("Group '%s' not found in HDF5 file", genome.c_str());
+        fail("Group '%s' not found in HDF5 file", genome.c_str());
     }
 
     // Read non-zero matrix entries in CSC format.
@@ -127,20 +185,20 @@ SvtSparseMatrix Hdf5FileReader::read(hid_t file, const TenxFileParams &params) {
 
     // Check that datasets exist.
     if (H5Lexists(file, indices_dataset.c_str(), H5P_DEFAULT) <= 0) {
-        stop("Dataset '%s' not found in HDF5 file", indices_dataset.c_str());
+        fail("Dataset '%s' not found in HDF5 file", indices_dataset.c_str());
     }
     if (H5Lexists(file, data_dataset.c_str(), H5P_DEFAULT) <= 0) {
-        stop("Dataset '%s' not found in HDF5 file", data_dataset.c_str());
+        fail("Dataset '%s' not found in HDF5 file", data_dataset.c_str());
     }
     if (H5Lexists(file, indptr_dataset.c_str(), H5P_DEFAULT) <= 0) {
-        stop("Dataset '%s' not found in HDF5 file", indptr_dataset.c_str());
+        fail("Dataset '%s' not found in HDF5 file", indptr_dataset.c_str());
     }
 
     const auto nz_rows = readDataset<uint32_t>(file, indices_dataset);
     const auto nz_data = readDataset<uint32_t>(file, data_dataset);
     const auto col_inds = readDataset<uint32_t>(file, indptr_dataset);
     if (nz_rows.size() != nz_data.size()) {
-        stop(
+        fail(
             "Inconsistent HDF5 dataset sizes. Datasets \"%s\" and \"%s\" "
             "specify a different number of non-zero entries (%zu vs. %zu).",
             indices_dataset, data_dataset, nz_rows.size(), nz_data.size());
@@ -149,11 +207,11 @@ SvtSparseMatrix Hdf5FileReader::read(hid_t file, const TenxFileParams &params) {
     // Read matrix dimensions.
     const std::string shape_dataset = shapeDataset(params);
     if (H5Lexists(file, shape_dataset.c_str(), H5P_DEFAULT) <= 0) {
-        stop("Dataset '%s' not found in HDF5 file", shape_dataset.c_str());
+        fail("Dataset '%s' not found in HDF5 file", shape_dataset.c_str());
     }
     const auto dims = readDataset<uint64_t>(file, shape_dataset);
     if (dims.size() != 2) {
-        stop(
+        fail(
             "Invalid matrix dimensions. Dataset \"%s\" has %zu entries "
             "(expected 2).",
             shape_dataset, dims.size());
@@ -162,37 +220,58 @@ SvtSparseMatrix Hdf5FileReader::read(hid_t file, const TenxFileParams &params) {
     // Read row and column names.
     const std::string features_dataset = featuresDataset(params);
     if (H5Lexists(file, features_dataset.c_str(), H5P_DEFAULT) <= 0) {
-        stop("Dataset '%s' not found in HDF5 file", features_dataset.c_str());
+        fail("Dataset '%s' not found in HDF5 file", features_dataset.c_str());
     }
-    auto row_names = readDataset<std::string>(file, features_dataset);
+    NameTable row_names = readNamesDataset(file, features_dataset);
     if (row_names.size() != dims[0]) {
-        warning(
+        warn(
             "Datasets \"%s\" and \"%s\" specify a different number of rows "
             "(%zu vs. %zu).",
             shape_dataset, features_dataset, dims[0], row_names.size());
     }
-    std::vector<std::string> col_names{};
+    NameTable col_names;
     if (params.use_barcode_col_names) {
         const std::string barcodes_dataset = barcodesDataset(params);
         if (H5Lexists(file, barcodes_dataset.c_str(), H5P_DEFAULT) <= 0) {
-            stop("Dataset '%s' not found in HDF5 file",
+            fail("Dataset '%s' not found in HDF5 file",
                  barcodes_dataset.c_str());
         }
-        col_names = readDataset<std::string>(file, barcodes_dataset);
+        col_names = readNamesDataset(file, barcodes_dataset);
         if (col_names.size() != dims[1]) {
-            warning(
+            warn(
                 "Datasets \"%s\" and \"%s\" specify a different number of "
                 "columns (%zu vs. %zu).",
                 shape_dataset, barcodes_dataset, dims[1], col_names.size());
         }
     }
 
+    // Size the QC accumulators and flag mitochondrial features by gene symbol,
+    // falling back to the row names if the symbols are not stored.
+    if (qc != nullptr) {
+        qc->resize(dims[0], dims[1]);
+        const std::string symbols_dataset =
+            featuresDataset(params, /*use_ids=*/false);
+        if (params.use_id_row_names &&
+            H5Lexists(file, symbols_dataset.c_str(), H5P_DEFAULT) > 0) {
+            qc->flagMitoFeatures(readNamesDataset(file, symbols_dataset));
+        } else {
+            qc->flagMitoFeatures(row_names);
+        }
+    }
+
     // Initialize SVT matrix with dims[1] columns, each containing 2 vectors
     // with row and value information.
     Svt svt(dims[1], SvtEntry(2));
 
+    ScopedStage build_stage("build_svt");
     int col = 0;
     const int num_cols = col_inds.size() - 1;
+    if (col_inds.empty() || col_inds.size() > dims[1] + 1) {
+        fail(
+            "Invalid matrix dimensions. Dataset \"%s\" has %zu entries "
+            "(expected %zu).",
+            indptr_dataset, col_inds.size(), dims[1] + 1);
+    }
     for (int i = 0; i < nz_rows.size(); i++) {
         while (col < num_cols && (col_inds[col + 1] <= i)) {
             col++;
@@ -200,9 +279,20 @@ SvtSparseMatrix Hdf5FileReader::read(hid_t file, const TenxFileParams &params) {
         if (col == num_cols) {
             break;
         }
+        if (nz_rows[i] >= dims[0]) {
+            fail(
+                "Invalid row index. Entry %d of dataset \"%s\" is %u, but the "
+                "matrix has %zu rows.",
+                i + 1, indices_dataset, nz_rows[i], dims[0]);
+        }
         svt[col][kSvtRowInd].emplace_back(static_cast<int>(nz_rows[i]));
         svt[col][kSvtValInd].emplace_back(static_cast<int>(nz_data[i]));
+        if (qc != nullptr) {
+            qc->add(nz_rows[i], col, nz_data[i]);
+        }
     }
+    build_stage.addNnz(nz_data.size());
+    stage.addNnz(nz_data.size());
 
     return SvtSparseMatrix(std::move(svt),
                            MatrixMetadata{.nrow = static_cast<int>(dims[0]),
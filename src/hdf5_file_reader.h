@@ -5,6 +5,7 @@
 #include <string>
 
 #include "hdf5.h"
+#include "qc_metrics.h"
 #include "sparse_matrix.h"
 #include "tenx_file_params.h"
 
@@ -13,8 +14,10 @@ namespace smallcount {
 // File reader to construct sparse matrices from Cell Ranger HDF5 files.
 class Hdf5FileReader {
    public:
-    // Converts the contents of an HDF5 file into an SvtSparseMatrix.
-    static SvtSparseMatrix read(hid_t file, const TenxFileParams &params);
+    // Converts the contents of an HDF5 file into an SvtSparseMatrix. If `qc` is
+    // non-null, QC metrics are accumulated into it during the same pass.
+    static SvtSparseMatrix read(hid_t file, const TenxFileParams &params,
+                                QcMetrics *qc = nullptr);
 
    private:
     // Static class. Should not be instantiated.
@@ -0,0 +1,278 @@
+#include "hdf5_file_writer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "error.h"
+#include "hdf5.h"
+#include "matrix_names.h"
+#include "name_table.h"
+#include "output_file.h"
+#include "profiler.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+namespace {
+
+// Name of the HDF5 group containing the matrix datasets.
+static constexpr char kGroup[] = "matrix";
+// Feature type of each row.
+static constexpr char kFeatureType[] = "Gene Expression";
+// Elements per chunk of the compressed datasets.
+static constexpr size_t kChunkSize = 1 << 16;
+// Chunks filled (and compressed) at once, per batch.
+static constexpr size_t kChunksPerBatch = 64;
+// Level of the deflate filter (zlib's default level, as used by
+// deflateBlock for the chunks compressed in parallel).
+static constexpr unsigned kDeflateLevel = 6;
+
+// HDF5 object (e.g., a dataset or group) that is closed when it goes out of
+// scope, including when writing fails.
+class Hdf5Object {
+   public:
+    Hdf5Object(hid_t id, herr_t (*close)(hid_t)) : id(id), close(close) {}
+    ~Hdf5Object() {
+        if (id >= 0) {
+            close(id);
+        }
+    }
+    Hdf5Object(const Hdf5Object &) = delete;
+    Hdf5Object &operator=(const Hdf5Object &) = delete;
+
+    operator hid_t() const { return id; }
+
+   private:
+    hid_t id;
+    herr_t (*close)(hid_t);
+};
+
+// HDF5 type of each element type of the numeric datasets.
+template <typename T>
+hid_t nativeType();
+template <>
+hid_t nativeType<uint32_t>() {
+    return H5T_NATIVE_UINT32;
+}
+template <>
+hid_t nativeType<int64_t>() {
+    return H5T_NATIVE_INT64;
+}
+
+// Creates a 1-dimensional dataset, chunked and deflated if `chunk_size` is
+// non-zero.
+hid_t createDataset(hid_t group, const std::string &name, hid_t type,
+                    hsize_t size, hsize_t chunk_size, unsigned level) {
+    Hdf5Object dataspace(H5Screate_simple(1, &size, nullptr), H5Sclose);
+    Hdf5Object properties(H5Pcreate(H5P_DATASET_CREATE), H5Pclose);
+    if (chunk_size > 0) {
+        H5Pset_chunk(properties, 1, &chunk_size);
+        H5Pset_deflate(properties, level);
+    }
+    hid_t dataset = H5Dcreate2(group, name.c_str(), type, dataspace,
+                               H5P_DEFAULT, properties, H5P_DEFAULT);
+    if (dataset < 0) {
+        fail("Could not create dataset '%s' in HDF5 file", name);
+    }
+    return dataset;
+}
+
+// Writes `count` elements at `offset` of a 1-dimensional dataset.
+template <typename T>
+void writeSlab(hid_t dataset, const T *data, hsize_t offset, hsize_t count) {
+    Hdf5Object file_space(H5Dget_space(dataset), H5Sclose);
+    H5Sselect_hyperslab(file_space, H5S_SELECT_SET, &offset, nullptr, &count,
+                        nullptr);
+    Hdf5Object mem_space(H5Screate_simple(1, &count, nullptr), H5Sclose);
+    if (H5Dwrite(dataset, nativeType<T>(), mem_space, file_space,
+                 H5P_DEFAULT, data) < 0) {
+        fail("Could not write to HDF5 dataset");
+    }
+}
+
+// Writes a numeric dataset of `size` elements, where `fill(begin, end, out)`
+// writes elements [begin, end) to `out`. The dataset is written in chunks
+// that are filled (and deflated, if `compress` is true) in parallel, then
+// written in order, so that the dataset is never held in memory.
+template <typename T, typename Fill>
+void writeNumericDataset(hid_t group, const std::string &name, size_t size,
+                         bool compress, Fill &&fill) {
+    ScopedStage stage("write_dataset");
+    compress = compress && size > 0;
+    const size_t chunk_size =
+        compress ? std::min(size, kChunkSize) : kChunkSize;
+    Hdf5Object dataset(createDataset(group, name, nativeType<T>(), size,
+                                     compress ? chunk_size : 0,
+                                     kDeflateLevel),
+                       H5Dclose);
+    const size_t num_chunks = (size + chunk_size - 1) / chunk_size;
+    std::vector<std::vector<T>> chunks;
+    std::vector<std::string> compressed;
+    for (size_t start = 0; start < num_chunks; start += kChunksPerBatch) {
+        const size_t batch_size =
+            std::min(kChunksPerBatch, num_chunks - start);
+        chunks.assign(batch_size, std::vector<T>());
+        compressed.assign(batch_size, std::string());
+        bool failed = false;
+#pragma omp parallel for schedule(dynamic, 1) reduction(|| : failed)
+        for (size_t c = 0; c < batch_size; c++) {
+            const size_t begin = (start + c) * chunk_size;
+            const size_t end = std::min(size, begin + chunk_size);
+            // Stored chunks are full, so the last one is zero-padded.
+            chunks[c].assign(chunk_size, 0);
+            fill(begin, end, chunks[c].data());
+            if (compress) {
+                const char *bytes =
+                    reinterpret_cast<const char *>(chunks[c].data());
+                if (!deflateBlock(bytes, chunk_size * sizeof(T),
+                                  /*gzip=*/false, &compressed[c])) {
+                    failed = true;
+                }
+                std::vector<T>().swap(chunks[c]);
+            }
+        }
+        if (failed) {
+            fail("Could not compress HDF5 dataset '%s'", name);
+        }
+        for (size_t c = 0; c < batch_size; c++) {
+            const hsize_t offset = (start + c) * chunk_size;
+            if (!compress) {
+                const hsize_t count = std::min<hsize_t>(size - offset,
+                                                        chunk_size);
+                writeSlab(dataset, chunks[c].data(), offset, count);
+            } else if (H5Dwrite_chunk(dataset, H5P_DEFAULT, /*filters=*/0,
+                                      &offset, compressed[c].size(),
+                                      compressed[c].data()) < 0) {
+                fail("Could not write to HDF5 dataset '%s'", name);
+            }
+        }
+    }
+    stage.addNnz(size);
+}
+
+// Writes a dataset of fixed-length, null-padded strings.
+void writeNamesDataset(hid_t group, const std::string &name,
+                       const NameTable &names, bool compress) {
+    ScopedStage stage("write_names");
+    size_t str_size = 1;
+    for (size_t i = 0; i < names.size(); i++) {
+        str_size = std::max(str_size, names[i].size());
+    }
+    std::string buffer(names.size() * str_size, '\0');
+    for (size_t i = 0; i < names.size(); i++) {
+        names[i].copy(buffer.data() + i * str_size, str_size);
+    }
+    Hdf5Object type(H5Tcopy(H5T_C_S1), H5Tclose);
+    H5Tset_size(type, str_size);
+    H5Tset_strpad(type, H5T_STR_NULLPAD);
+    const hsize_t chunk_size =
+        compress ? std::min<hsize_t>(names.size(), kChunkSize) : 0;
+    Hdf5Object dataset(createDataset(group, name, type, names.size(),
+                                     chunk_size, kDeflateLevel),
+                       H5Dclose);
+    if (H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                 buffer.data()) < 0) {
+        fail("Could not write to HDF5 dataset '%s'", name);
+    }
+}
+
+// Returns `size` copies of a name.
+NameTable repeatedName(std::string_view name, size_t size) {
+    NameTable names;
+    for (size_t i = 0; i < size; i++) {
+        names.append(name);
+    }
+    return names;
+}
+
+// Creates a group, failing if it cannot be created.
+hid_t createGroup(hid_t parent, const char *name) {
+    hid_t group = H5Gcreate2(parent, name, H5P_DEFAULT, H5P_DEFAULT,
+                             H5P_DEFAULT);
+    if (group < 0) {
+        fail("Could not create group '%s' in HDF5 file", name);
+    }
+    return group;
+}
+
+}  // namespace
+
+void Hdf5FileWriter::write(const SparseColumns &matrix,
+                           const MatrixNames &names, hid_t file,
+                           bool compress) {
+    ScopedStage stage("hdf5");
+    checkNameCount(names.feature_ids, matrix.nrow, "feature IDs");
+    checkNameCount(names.feature_names, matrix.nrow, "feature names");
+    checkNameCount(names.barcodes, matrix.ncol, "barcodes");
+    // Without the deflate filter, the chunks could not be read back.
+    compress = compress && H5Zfilter_avail(H5Z_FILTER_DEFLATE) > 0;
+
+    // Offsets of the non-zero entries of each column.
+    const std::vector<size_t> counts = countNonZeros(matrix);
+    std::vector<int64_t> indptr(counts.size() + 1, 0);
+    for (size_t j = 0; j < counts.size(); j++) {
+        indptr[j + 1] = indptr[j] + counts[j];
+    }
+    const size_t nnz = indptr.back();
+
+    // Calls `f(row, value)` for the non-zero entries [begin, end), in
+    // column-major order.
+    auto forEachEntry = [&](size_t begin, size_t end, auto &&f) {
+        size_t j = std::upper_bound(indptr.begin(), indptr.end(), begin) -
+                   indptr.begin() - 1;
+        size_t p = indptr[j];
+        for (; p < end && j < counts.size(); j++) {
+            matrix.columns[j].forEach([&](int row, double value) {
+                if (value == 0 || p >= end) {
+                    return;
+                }
+                if (p >= begin) {
+                    f(row, value);
+                }
+                p++;
+            });
+        }
+    };
+
+    Hdf5Object group(createGroup(file, kGroup), H5Gclose);
+    writeNumericDataset<uint32_t>(
+        group, "data", nnz, compress,
+        [&](size_t begin, size_t end, uint32_t *out) {
+            forEachEntry(begin, end, [&](int, double value) {
+                *out++ = static_cast<uint32_t>(value);
+            });
+        });
+    writeNumericDataset<uint32_t>(
+        group, "indices", nnz, compress,
+        [&](size_t begin, size_t end, uint32_t *out) {
+            forEachEntry(begin, end,
+                         [&](int row, double) { *out++ = row; });
+        });
+    writeNumericDataset<int64_t>(
+        group, "indptr", indptr.size(), compress,
+        [&](size_t begin, size_t end, int64_t *out) {
+            std::copy(indptr.begin() + begin, indptr.begin() + end, out);
+        });
+    writeNumericDataset<int64_t>(
+        group, "shape", 2, /*compress=*/false,
+        [&](size_t begin, size_t end, int64_t *out) {
+            const int64_t shape[] = {matrix.nrow, matrix.ncol};
+            std::copy(shape + begin, shape + end, out);
+        });
+    writeNamesDataset(group, "barcodes", names.barcodes, compress);
+
+    Hdf5Object features(createGroup(group, "features"), H5Gclose);
+    writeNamesDataset(features, "id", names.feature_ids, compress);
+    writeNamesDataset(features, "name", names.feature_names, compress);
+    writeNamesDataset(features, "feature_type",
+                      repeatedName(kFeatureType, matrix.nrow), compress);
+    writeNamesDataset(features, "genome", repeatedName("", matrix.nrow),
+                      compress);
+    writeNamesDataset(features, "_all_tag_keys", repeatedName("genome", 1),
+                      /*compress=*/false);
+    stage.addNnz(nnz);
+}
+
+}  // namespace smallcount
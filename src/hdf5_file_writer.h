@@ -0,0 +1,27 @@
+#ifndef SMALLCOUNT_HDF5_FILE_WRITER_H_
+#define SMALLCOUNT_HDF5_FILE_WRITER_H_
+
+#include "hdf5.h"
+#include "matrix_names.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+// File writer to store sparse matrices as Cell Ranger HDF5 files.
+class Hdf5FileWriter {
+   public:
+    // Writes a matrix to the "matrix" group of an HDF5 file, in the Cell
+    // Ranger v3 layout read by Hdf5FileReader. If `compress` is true, the
+    // numeric datasets are chunked and deflated, with the chunks compressed
+    // in parallel.
+    static void write(const SparseColumns &matrix, const MatrixNames &names,
+                      hid_t file, bool compress);
+
+   private:
+    // Static class. Should not be instantiated.
+    Hdf5FileWriter() = default;
+};
+
+}  // namespace smallcount
+
+#endif
@@ -0,0 +1,443 @@
+#include "knn_graph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "error.h"
+#include "parallel.h"
+#include "profiler.h"
+
+namespace smallcount {
+namespace {
+
+constexpr double kInfinity = std::numeric_limits<double>::infinity();
+constexpr uint64_t kSeedStride = 0x9E3779B97F4A7C15;  // 2^64 / golden ratio
+constexpr int kQueryBlock = 16;  // Queries compared with each point at once
+// Bound on the neighbor updates proposed by a batch of points in NN-descent,
+// which are buffered (16 bytes each) until applied.
+constexpr size_t kMaxBatchUpdates = size_t{1} << 22;
+
+void checkK(int num_points, int k) {
+    if (k < 1 || k >= num_points) {
+        fail("k must be between 1 and the number of points minus one (got %d "
+             "for %d points).",
+             k, num_points);
+    }
+}
+
+// Copies a column-major matrix so that the coordinates of each point are
+// contiguous.
+std::vector<double> pointMajor(const double *x, int num_points, int dim) {
+    std::vector<double> points(static_cast<size_t>(num_points) * dim);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_points; i++) {
+        for (int d = 0; d < dim; d++) {
+            points[static_cast<size_t>(i) * dim + d] =
+                x[i + static_cast<size_t>(d) * num_points];
+        }
+    }
+    return points;
+}
+
+// Squared Euclidean distance, vectorized over the dimensions.
+inline double squaredDistance(const double *a, const double *b, int dim) {
+    double sum = 0;
+#pragma omp simd reduction(+ : sum)
+    for (int d = 0; d < dim; d++) {
+        const double diff = a[d] - b[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// Squared Euclidean distances from a point to a block of kQueryBlock queries
+// whose coordinates are stored dimension by dimension, vectorized over the
+// queries.
+inline void blockDistances(const double *queries, const double *point,
+                           int dim, double *distances) {
+    double sums[kQueryBlock] = {};
+    for (int d = 0; d < dim; d++) {
+        const double coordinate = point[d];
+        const double *query = queries + static_cast<size_t>(d) * kQueryBlock;
+#pragma omp simd
+        for (int q = 0; q < kQueryBlock; q++) {
+            const double diff = query[q] - coordinate;
+            sums[q] += diff * diff;
+        }
+    }
+    std::copy(sums, sums + kQueryBlock, distances);
+}
+
+// Max-heap of the nearest neighbors of one point found so far, stored in its
+// rows of the graph matrices, with the farthest neighbor at the root. Empty
+// slots have index -1 and an infinite distance.
+class NeighborHeap {
+   public:
+    NeighborHeap(KnnGraph *graph, std::vector<uint8_t> *is_new, int point)
+        : indices(&graph->indices[static_cast<size_t>(point) * graph->k]),
+          distances(&graph->distances[static_cast<size_t>(point) * graph->k]),
+          is_new(is_new == nullptr
+                     ? nullptr
+                     : &(*is_new)[static_cast<size_t>(point) * graph->k]),
+          k(graph->k) {}
+
+    double worst() const { return distances[0]; }
+
+    // Replaces the farthest neighbor with `j` if `j` is closer and is not
+    // already a neighbor. New neighbors are flagged as such.
+    bool push(int j, double distance) {
+        if (distance >= distances[0] ||
+            std::find(indices, indices + k, j) != indices + k) {
+            return false;
+        }
+        int pos = 0;
+        while (true) {
+            int child = 2 * pos + 1;
+            if (child >= k) {
+                break;
+            }
+            if (child + 1 < k && distances[child + 1] > distances[child]) {
+                child++;
+            }
+            if (distances[child] <= distance) {
+                break;
+            }
+            move(child, pos);
+            pos = child;
+        }
+        indices[pos] = j;
+        distances[pos] = distance;
+        if (is_new != nullptr) {
+            is_new[pos] = 1;
+        }
+        return true;
+    }
+
+   private:
+    void move(int from, int to) {
+        indices[to] = indices[from];
+        distances[to] = distances[from];
+        if (is_new != nullptr) {
+            is_new[to] = is_new[from];
+        }
+    }
+
+    int *indices;
+    double *distances;
+    uint8_t *is_new;
+    int k;
+};
+
+KnnGraph emptyGraph(int num_points, int k) {
+    KnnGraph graph;
+    graph.num_points = num_points;
+    graph.k = k;
+    graph.indices.assign(static_cast<size_t>(num_points) * k, -1);
+    graph.distances.assign(static_cast<size_t>(num_points) * k, kInfinity);
+    return graph;
+}
+
+// Sorts the neighbors of each point by increasing distance (ties by index)
+// and converts the squared distances to distances.
+void sortNeighbors(KnnGraph *graph) {
+    const int k = graph->k;
+#pragma omp parallel
+    {
+        std::vector<std::pair<double, int>> row(k);
+#pragma omp for schedule(static)
+        for (int i = 0; i < graph->num_points; i++) {
+            int *indices = &graph->indices[static_cast<size_t>(i) * k];
+            double *distances = &graph->distances[static_cast<size_t>(i) * k];
+            for (int s = 0; s < k; s++) {
+                row[s] = {distances[s], indices[s]};
+            }
+            std::sort(row.begin(), row.end());
+            for (int s = 0; s < k; s++) {
+                distances[s] = std::sqrt(row[s].first);
+                indices[s] = row[s].second;
+            }
+        }
+    }
+}
+
+// Bounded random sample of the join candidates of each point, filled by
+// reservoir sampling.
+class CandidateSample {
+   public:
+    CandidateSample(int num_points, int capacity)
+        : capacity(capacity),
+          candidates(static_cast<size_t>(num_points) * capacity),
+          counts(num_points, 0),
+          seen(num_points, 0) {}
+
+    void add(int point, int candidate, std::mt19937_64 &rng) {
+        int *sample = &candidates[static_cast<size_t>(point) * capacity];
+        const uint64_t num_seen = ++seen[point];
+        if (counts[point] < capacity) {
+            sample[counts[point]++] = candidate;
+            return;
+        }
+        const uint64_t slot = rng() % num_seen;
+        if (slot < static_cast<uint64_t>(capacity)) {
+            sample[slot] = candidate;
+        }
+    }
+
+    const int *begin(int point) const {
+        return &candidates[static_cast<size_t>(point) * capacity];
+    }
+    const int *end(int point) const { return begin(point) + counts[point]; }
+
+   private:
+    int capacity;
+    std::vector<int> candidates;
+    std::vector<int> counts;
+    std::vector<uint64_t> seen;
+};
+
+// Proposed neighbor `source` of point `target`.
+struct Update {
+    int target;
+    int source;
+    double distance;
+};
+
+// Sorted union of the forward and reverse candidates of a point.
+void mergeCandidates(const CandidateSample &forward,
+                     const CandidateSample &reverse, int point,
+                     std::vector<int> *merged) {
+    merged->assign(forward.begin(point), forward.end(point));
+    merged->insert(merged->end(), reverse.begin(point), reverse.end(point));
+    std::sort(merged->begin(), merged->end());
+    merged->erase(std::unique(merged->begin(), merged->end()), merged->end());
+}
+
+// Applies the updates proposed by each thread (releasing them) in parallel over
+// their targets, in a fixed order for each target so that the result does not
+// depend on the number of threads. `counts` holds a zero for each point, and
+// is left so. Returns the number of neighbors that changed.
+long applyUpdates(std::vector<std::vector<Update>> *updates, KnnGraph *graph,
+                  std::vector<uint8_t> *is_new, std::vector<size_t> *counts) {
+    // Count the updates of each target, then turn the counts into the offset
+    // of the next update of each target in `by_target`.
+    std::vector<int> targets;
+    size_t total = 0;
+    for (const std::vector<Update> &thread_updates : *updates) {
+        for (const Update &update : thread_updates) {
+            if ((*counts)[update.target]++ == 0) {
+                targets.push_back(update.target);
+            }
+        }
+        total += thread_updates.size();
+    }
+    const int num_targets = targets.size();
+    std::vector<size_t> offsets(static_cast<size_t>(num_targets) + 1, 0);
+    for (int t = 0; t < num_targets; t++) {
+        offsets[t + 1] = offsets[t] + (*counts)[targets[t]];
+        (*counts)[targets[t]] = offsets[t];
+    }
+    std::vector<Update> by_target(total);
+    for (std::vector<Update> &thread_updates : *updates) {
+        for (const Update &update : thread_updates) {
+            by_target[(*counts)[update.target]++] = update;
+        }
+        std::vector<Update>().swap(thread_updates);
+    }
+
+    long num_changed = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+ : num_changed)
+    for (int t = 0; t < num_targets; t++) {
+        Update *begin = by_target.data() + offsets[t];
+        Update *end = by_target.data() + offsets[t + 1];
+        std::sort(begin, end, [](const Update &a, const Update &b) {
+            return a.distance < b.distance ||
+                   (a.distance == b.distance && a.source < b.source);
+        });
+        NeighborHeap heap(graph, is_new, targets[t]);
+        for (Update *update = begin; update != end; update++) {
+            num_changed += heap.push(update->source, update->distance);
+        }
+        (*counts)[targets[t]] = 0;
+    }
+    return num_changed;
+}
+
+}  // namespace
+
+KnnGraph exactKnn(const double *x, int num_points, int dim, int k) {
+    ScopedStage stage("knn_exact");
+    checkK(num_points, k);
+    const std::vector<double> points = pointMajor(x, num_points, dim);
+    KnnGraph graph = emptyGraph(num_points, k);
+    // Each point is compared with a block of queries at once, with the
+    // coordinates of the queries stored dimension by dimension so that the
+    // distances to all of them are computed in the same vector lanes.
+    const int num_blocks = (num_points + kQueryBlock - 1) / kQueryBlock;
+#pragma omp parallel
+    {
+        std::vector<double> queries(static_cast<size_t>(dim) * kQueryBlock);
+        std::vector<double> block_distances(kQueryBlock);
+#pragma omp for schedule(dynamic, 1)
+        for (int block = 0; block < num_blocks; block++) {
+            const int begin = block * kQueryBlock;
+            const int size = std::min(kQueryBlock, num_points - begin);
+            std::fill(queries.begin(), queries.end(), 0.0);
+            for (int q = 0; q < size; q++) {
+                for (int d = 0; d < dim; d++) {
+                    queries[static_cast<size_t>(d) * kQueryBlock + q] =
+                        points[static_cast<size_t>(begin + q) * dim + d];
+                }
+            }
+            std::vector<NeighborHeap> heaps;
+            for (int q = 0; q < size; q++) {
+                heaps.emplace_back(&graph, nullptr, begin + q);
+            }
+            for (int j = 0; j < num_points; j++) {
+                blockDistances(queries.data(),
+                               &points[static_cast<size_t>(j) * dim], dim,
+                               block_distances.data());
+                for (int q = 0; q < size; q++) {
+                    if (block_distances[q] < heaps[q].worst() &&
+                        begin + q != j) {
+                        heaps[q].push(j, block_distances[q]);
+                    }
+                }
+            }
+        }
+    }
+    sortNeighbors(&graph);
+    return graph;
+}
+
+KnnGraph nnDescentKnn(const double *x, int num_points, int dim, int k,
+                      const NnDescentParams &params) {
+    ScopedStage stage("knn_nn_descent");
+    checkK(num_points, k);
+    const std::vector<double> points = pointMajor(x, num_points, dim);
+    auto distance = [&](int a, int b) {
+        return squaredDistance(&points[static_cast<size_t>(a) * dim],
+                               &points[static_cast<size_t>(b) * dim], dim);
+    };
+    KnnGraph graph = emptyGraph(num_points, k);
+    std::vector<uint8_t> is_new(graph.indices.size(), 0);
+
+    // Start from k distinct random neighbors of each point.
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_points; i++) {
+        std::mt19937_64 rng(params.seed + kSeedStride * (i + 1));
+        std::uniform_int_distribution<int> other(0, num_points - 2);
+        NeighborHeap heap(&graph, &is_new, i);
+        for (int found = 0; found < k;) {
+            int j = other(rng);
+            j += j >= i;
+            found += heap.push(j, distance(i, j));
+        }
+    }
+
+    const int capacity =
+        std::max(1, static_cast<int>(std::ceil(params.sample_rate * k)));
+    const double min_updates = params.delta * num_points * k;
+    // A point has at most 2 * capacity new and 2 * capacity old candidates,
+    // whose pairs propose at most 12 * capacity^2 updates.
+    const size_t max_point_updates =
+        12 * static_cast<size_t>(capacity) * capacity;
+    const int batch_size = static_cast<int>(std::min<size_t>(
+        num_points, std::max<size_t>(1, kMaxBatchUpdates / max_point_updates)));
+    std::vector<std::vector<Update>> updates;
+    std::vector<size_t> counts(num_points, 0);
+    for (int iteration = 0; iteration < params.max_iterations; iteration++) {
+        // Sample the new and old neighbors of each point, and the points of
+        // which it is a sampled neighbor. Sampled new neighbors become old.
+        std::mt19937_64 rng(params.seed ^ (kSeedStride * (iteration + 1)));
+        CandidateSample new_forward(num_points, capacity);
+        CandidateSample old_forward(num_points, capacity);
+        CandidateSample new_reverse(num_points, capacity);
+        CandidateSample old_reverse(num_points, capacity);
+        for (int i = 0; i < num_points; i++) {
+            const size_t row = static_cast<size_t>(i) * k;
+            for (int s = 0; s < k; s++) {
+                CandidateSample &sample =
+                    is_new[row + s] ? new_forward : old_forward;
+                sample.add(i, graph.indices[row + s], rng);
+            }
+            for (int s = 0; s < k; s++) {
+                if (std::find(new_forward.begin(i), new_forward.end(i),
+                              graph.indices[row + s]) != new_forward.end(i)) {
+                    is_new[row + s] = 0;
+                }
+            }
+        }
+        for (int i = 0; i < num_points; i++) {
+            for (const int *j = new_forward.begin(i); j != new_forward.end(i);
+                 j++) {
+                new_reverse.add(*j, i, rng);
+            }
+            for (const int *j = old_forward.begin(i); j != old_forward.end(i);
+                 j++) {
+                old_reverse.add(*j, i, rng);
+            }
+        }
+
+        // Compare the new candidates of each point with each other and with
+        // the old candidates, proposing the pairs closer than a current
+        // neighbor. The points are processed in batches whose updates are
+        // applied before the next batch, so that the buffered updates stay
+        // bounded. The heaps are only read while a batch is proposed.
+        long num_changed = 0;
+        for (int batch = 0; batch < num_points; batch += batch_size) {
+            const int batch_end = std::min(num_points, batch + batch_size);
+#pragma omp parallel
+            {
+                const int thread = threadIndex();
+#pragma omp single
+                updates.resize(threadCount());
+
+                std::vector<Update> &thread_updates = updates[thread];
+                std::vector<int> new_candidates;
+                std::vector<int> old_candidates;
+                auto propose = [&](int a, int b) {
+                    const double d = distance(a, b);
+                    if (d < graph.distances[static_cast<size_t>(a) * k]) {
+                        thread_updates.push_back({a, b, d});
+                    }
+                    if (d < graph.distances[static_cast<size_t>(b) * k]) {
+                        thread_updates.push_back({b, a, d});
+                    }
+                };
+#pragma omp for schedule(dynamic, 64)
+                for (int i = batch; i < batch_end; i++) {
+                    mergeCandidates(new_forward, new_reverse, i,
+                                    &new_candidates);
+                    mergeCandidates(old_forward, old_reverse, i,
+                                    &old_candidates);
+                    for (size_t p = 0; p < new_candidates.size(); p++) {
+                        const int a = new_candidates[p];
+                        for (size_t q = p + 1; q < new_candidates.size();
+                             q++) {
+                            propose(a, new_candidates[q]);
+                        }
+                        for (const int b : old_candidates) {
+                            if (a != b) {
+                                propose(a, b);
+                            }
+                        }
+                    }
+                }
+            }
+            num_changed += applyUpdates(&updates, &graph, &is_new, &counts);
+        }
+        if (num_changed <= min_updates) {
+            break;
+        }
+    }
+    sortNeighbors(&graph);
+    return graph;
+}
+
+}  // namespace smallcount
@@ -0,0 +1,47 @@
+#ifndef SMALLCOUNT_KNN_GRAPH_H_
+#define SMALLCOUNT_KNN_GRAPH_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace smallcount {
+
+// k nearest neighbors of each point, by Euclidean distance. Each matrix is
+// num_points x k, row-major, with the neighbors of each point sorted by
+// increasing distance (ties by index). A point is not its own neighbor.
+struct KnnGraph {
+    int num_points = 0;
+    int k = 0;
+    std::vector<int> indices;       // 0-based index of each neighbor
+    std::vector<double> distances;  // Distance to each neighbor
+};
+
+// Tuning of the approximate search. More candidates per point, more
+// iterations and a smaller convergence threshold raise the recall (the
+// fraction of true neighbors found) at the cost of more distance evaluations.
+struct NnDescentParams {
+    int max_iterations = 10;
+    // Fraction of the k neighbors sampled as join candidates per iteration.
+    double sample_rate = 0.5;
+    // Stops once fewer than delta * num_points * k neighbors change.
+    double delta = 0.001;
+    uint64_t seed = 1;
+};
+
+// Exact search, comparing every pair of points in parallel over the query
+// points. `x` is a num_points x dim column-major matrix (e.g., the PCA scores
+// of the cells).
+KnnGraph exactKnn(const double *x, int num_points, int dim, int k);
+
+// Approximate search by NN-descent (Dong, Charikar and Li, 2011): starting
+// from random neighbors, repeatedly compares the neighbors of the neighbors
+// of each point. Each iteration proposes neighbor updates in parallel over
+// bounded batches of points, applying those of a batch in parallel over the
+// updated points before the next, so the result only depends on the seed and
+// not on the number of threads.
+KnnGraph nnDescentKnn(const double *x, int num_points, int dim, int k,
+                      const NnDescentParams &params);
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_KNN_GRAPH_H_
@@ -0,0 +1,21 @@
+#ifndef SMALLCOUNT_MATRIX_NAMES_H_
+#define SMALLCOUNT_MATRIX_NAMES_H_
+
+#include "name_table.h"
+
+namespace smallcount {
+
+// Names written alongside the counts of a matrix, in the layout of the
+// CellRanger output files for 10x Genomics data.
+struct MatrixNames {
+    // Ensembl ID of each row (the row names of the matrix).
+    NameTable feature_ids;
+    // Gene symbol of each row. Not written to .csv files.
+    NameTable feature_names;
+    // Cell barcode of each column (the column names of the matrix).
+    NameTable barcodes;
+};
+
+}  // namespace smallcount
+
+#endif
@@ -1,16 +1,20 @@
 #include "mtx_file_reader.h"
 
 #include <cstdlib>
-#include <fstream>
+#include <cstring>
+#include <istream>
+#include <iterator>
 #include <optional>
 #include <string>
+#include <vector>
 
-#include "Rcpp.h"
+#include "error.h"
+#include "name_table.h"
+#include "profiler.h"
+#include "qc_metrics.h"
 #include "sparse_matrix.h"
 #include "tenx_file_params.h"
 
-using namespace Rcpp;
-
 namespace smallcount {
 namespace {
 
@@ -40,25 +44,84 @@ struct MtxLine {
     }
 };
 
-// Reads the first or second column from a .tsv file.
-std::vector<std::string> readTsvNames(std::ifstream &file,
-                                      const std::string &name, int size,
-                                      bool first_row) {
-    std::string line;
-    std::vector<std::string> names;
-    names.reserve(size);
-    while (std::getline(file, line)) {
-        size_t tab_index = line.find('\t');
-        if (tab_index == std::string::npos && !first_row) {
-            stop("Invalid features/genes. Could not locate second column.");
+// Reads the entire contents of a file into memory, in one read if the stream
+// is seekable (e.g., a file or a member of an archive read into memory).
+std::string readFileContents(std::istream &file) {
+    const std::streampos start = file.tellg();
+    if (start != std::streampos(-1) && file.seekg(0, std::ios::end)) {
+        const std::streamoff size = file.tellg() - start;
+        file.seekg(start);
+        std::string contents(size, '\0');
+        file.read(contents.data(), size);
+        return contents;
+    }
+    file.clear();
+    return std::string(std::istreambuf_iterator<char>(file),
+                       std::istreambuf_iterator<char>());
+}
+
+// Returns the end of the field starting at `start`, i.e., the position of the
+// next tab or `end`.
+size_t fieldEnd(const std::string &contents, size_t start, size_t end) {
+    const void *tab = memchr(contents.data() + start, '\t', end - start);
+    return tab == nullptr ? end
+                          : static_cast<const char *>(tab) - contents.data();
+}
+
+// Reads the first or second column from a .tsv file, or returns nullopt if
+// the second column is requested but missing.
+//
+// The file is read in one block, which then serves as the arena of the
+// returned names. Lines are located sequentially and their columns are parsed
+// in parallel.
+std::optional<NameTable> readTsvColumn(std::istream &file,
+                                       const std::string &name, int size,
+                                       bool first_row) {
+    ScopedStage stage("read_names");
+    std::string contents = readFileContents(file);
+    stage.addBytesRead(contents.size());
+
+    // Locate the [start, end) range of each line, excluding the newline.
+    std::vector<size_t> line_starts;
+    std::vector<size_t> line_ends;
+    line_starts.reserve(size);
+    line_ends.reserve(size);
+    for (size_t pos = 0; pos < contents.size();) {
+        const void *newline =
+            memchr(contents.data() + pos, '\n', contents.size() - pos);
+        const size_t end =
+            newline == nullptr
+                ? contents.size()
+                : static_cast<const char *>(newline) - contents.data();
+        line_starts.emplace_back(pos);
+        line_ends.emplace_back(end);
+        pos = end + 1;
+    }
+
+    const size_t num_lines = line_starts.size();
+    std::vector<NameTable::Span> spans(num_lines);
+    bool missing_column = false;
+#pragma omp parallel for reduction(|| : missing_column)
+    for (size_t i = 0; i < num_lines; i++) {
+        const size_t first_end =
+            fieldEnd(contents, line_starts[i], line_ends[i]);
+        if (first_row) {
+            spans[i] = {line_starts[i], first_end - line_starts[i]};
+        } else if (first_end == line_ends[i]) {
+            missing_column = true;
+        } else {
+            const size_t second_end =
+                fieldEnd(contents, first_end + 1, line_ends[i]);
+            spans[i] = {first_end + 1, second_end - first_end - 1};
         }
-        size_t start_index = first_row ? 0 : tab_index + 1;
-        size_t end_index =
-            first_row ? tab_index : line.find('\t', tab_index + 1);
-        names.emplace_back(line.substr(start_index, end_index - start_index));
     }
+    if (missing_column) {
+        return std::nullopt;
+    }
+
+    NameTable names(std::move(contents), std::move(spans));
     if (names.size() != size) {
-        warning(
+        warn(
             "Number of %s does not match the specifications in the metadata "
             "(%zu vs. %d)",
             name, names.size(), size);
@@ -66,15 +129,27 @@ std::vector<std::string> readTsvNames(std::ifstream &file,
     return names;
 }
 
+// Reads the first or second column from a .tsv file, failing if the second
+// column is requested but missing.
+NameTable readTsvNames(std::istream &file, const std::string &name, int size,
+                       bool first_row) {
+    std::optional<NameTable> names =
+        readTsvColumn(file, name, size, first_row);
+    if (!names.has_value()) {
+        fail("Invalid features/genes. Could not locate second column.");
+    }
+    return std::move(*names);
+}
+
 // Generates metadata with row and column names.
-MatrixMetadata createMetadata(MtxLine entry, std::ifstream &barcodes_file,
-                              std::ifstream &features_file,
+MatrixMetadata createMetadata(MtxLine entry, std::istream &barcodes_file,
+                              std::istream &features_file,
                               const TenxFileParams &params) {
     MatrixMetadata metadata = entry.metadata();
-    auto row_names =
+    NameTable row_names =
         readTsvNames(features_file, "features/genes", metadata.nrow,
                      /*first_row=*/params.use_id_row_names);
-    std::vector<std::string> col_names;
+    NameTable col_names;
     if (params.use_barcode_col_names) {
         col_names = readTsvNames(barcodes_file, "barcodes", metadata.ncol,
                                  /*first_row=*/true);
@@ -84,6 +159,28 @@ MatrixMetadata createMetadata(MtxLine entry, std::ifstream &barcodes_file,
     return metadata;
 }
 
+// Sizes the QC accumulators and flags mitochondrial features by gene symbol.
+void initQcMetrics(const MatrixMetadata &metadata, std::istream &features_file,
+                   const TenxFileParams &params, QcMetrics *qc) {
+    qc->resize(metadata.nrow, metadata.ncol);
+    if (!params.use_id_row_names) {
+        qc->flagMitoFeatures(metadata.row_names);
+        return;
+    }
+    // Row names are IDs, so re-read the symbols from the features file.
+    features_file.clear();
+    features_file.seekg(0);
+    const std::optional<NameTable> symbols = readTsvColumn(
+        features_file, "features/genes", metadata.nrow, /*first_row=*/false);
+    if (!symbols.has_value()) {
+        warn(
+            "No gene symbols in features/genes. Mitochondrial genes are not "
+            "flagged.");
+        return;
+    }
+    qc->flagMitoFeatures(*symbols);
+}
+
 // Parses a single line of an .mtx file.
 std::optional<MtxLine> parseMtxLine(const std::string &line, size_t line_num) {
     // Ignore comments.
@@ -98,7 +195,7 @@ std::optional<MtxLine> parseMtxLine(const std::string &line, size_t line_num) {
     result.col = strtol(str_end, &str_end, /*__base=*/10);
     result.val = strtol(str_end, &str_end, /*__base=*/10);
     if (result.row == 0 || result.col == 0 || result.val == 0) {
-        stop(
+        fail(
             "Unexpected entry. Line %zu does not specify three positive "
             "integers:\n%s",
             line_num, line);
@@ -109,18 +206,22 @@ std::optional<MtxLine> parseMtxLine(const std::string &line, size_t line_num) {
 
 }  // namespace
 
-SvtSparseMatrix MtxFileReader::read(std::ifstream &matrix_file,
-                                    std::ifstream &barcodes_file,
-                                    std::ifstream &features_file,
-                                    const TenxFileParams &params) {
+SvtSparseMatrix MtxFileReader::read(std::istream &matrix_file,
+                                    std::istream &barcodes_file,
+                                    std::istream &features_file,
+                                    const TenxFileParams &params,
+                                    QcMetrics *qc) {
+    ScopedStage stage("mtx");
     Svt svt;
     MatrixMetadata metadata;
 
     std::string line;
     size_t line_num = 0;
     size_t non_zero_count = 0;
+    size_t bytes_read = 0;
     while (std::getline(matrix_file, line)) {
         line_num++;
+        bytes_read += line.size() + 1;
         const auto entry = parseMtxLine(line, line_num);
         if (!entry.has_value()) {
             continue;
@@ -128,20 +229,35 @@ SvtSparseMatrix MtxFileReader::read(std::ifstream &matrix_file,
             metadata =
                 createMetadata(*entry, barcodes_file, features_file, params);
             svt = Svt(metadata.ncol, SvtEntry(2));
+            if (qc != nullptr) {
+                initQcMetrics(metadata, features_file, params, qc);
+            }
         } else {
+            if (entry->row < 1 || entry->row > metadata.nrow ||
+                entry->col < 1 || entry->col > metadata.ncol) {
+                fail(
+                    "Invalid entry. Line %zu is outside of the %d x %d matrix "
+                    "specified in the metadata:\n%s",
+                    line_num, metadata.nrow, metadata.ncol, line);
+            }
             svt[entry->col - 1][kSvtRowInd].emplace_back(entry->row - 1);
             svt[entry->col - 1][kSvtValInd].emplace_back(entry->val);
+            if (qc != nullptr) {
+                qc->add(entry->row - 1, entry->col - 1, entry->val);
+            }
             non_zero_count++;
         }
     }
 
     if (non_zero_count != metadata.nval) {
-        stop(
+        fail(
             "Inconsistent entry count. Number of non-zero entries does not "
             "match the total specified in the matrix metadata (%zu != %zu).",
             non_zero_count, metadata.nval);
     }
 
+    stage.addBytesRead(bytes_read);
+    stage.addNnz(non_zero_count);
     return SvtSparseMatrix(std::move(svt), std::move(metadata));
 }
 
@@ -1,8 +1,9 @@
 #ifndef SMALLCOUNT_MTX_FILE_READER_H_
 #define SMALLCOUNT_MTX_FILE_READER_H_
 
-#include <fstream>
+#include <istream>
 
+#include "qc_metrics.h"
 #include "sparse_matrix.h"
 #include "tenx_file_params.h"
 
@@ -12,11 +13,13 @@ namespace smallcount {
 class MtxFileReader {
    public:
     // Converts the contents of an .mtx file into an SvtSparseMatrix, labelling
-    // the rows and columns with features and barcodes, respectively.
-    static SvtSparseMatrix read(std::ifstream &matrix_file,
-                                std::ifstream &barcodes_file,
-                                std::ifstream &features_file,
-                                const TenxFileParams &params);
+    // the rows and columns with features and barcodes, respectively. If `qc`
+    // is non-null, QC metrics are accumulated into it during the same pass.
+    static SvtSparseMatrix read(std::istream &matrix_file,
+                                std::istream &barcodes_file,
+                                std::istream &features_file,
+                                const TenxFileParams &params,
+                                QcMetrics *qc = nullptr);
 
    private:
     // Static class. Should not be instantiated.
@@ -0,0 +1,102 @@
+#include "mtx_file_writer.h"
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "matrix_names.h"
+#include "name_table.h"
+#include "output_file.h"
+#include "profiler.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+namespace {
+
+// Header of a Matrix Market file of integer counts.
+static constexpr char kMtxHeader[] =
+    "%%MatrixMarket matrix coordinate integer general\n";
+// Feature type of each row of features.tsv.
+static constexpr char kFeatureType[] = "Gene Expression";
+// Non-zero entries (or names) formatted per block.
+static constexpr size_t kEntriesPerBlock = 1 << 16;
+static constexpr size_t kNamesPerBlock = 1 << 14;
+
+// Writes the non-zero entries of a matrix, in blocks of columns.
+void writeEntries(const SparseColumns &matrix, OutputFile &file) {
+    ScopedStage stage("write_entries");
+    const std::vector<size_t> counts = countNonZeros(matrix);
+    const size_t nnz = std::accumulate(counts.begin(), counts.end(), size_t{0});
+    std::string header = kMtxHeader;
+    appendInteger(&header, matrix.nrow);
+    header += ' ';
+    appendInteger(&header, matrix.ncol);
+    header += ' ';
+    appendInteger(&header, nnz);
+    header += '\n';
+    file.write(std::move(header));
+
+    const std::vector<size_t> blocks = splitBlocks(counts, kEntriesPerBlock);
+    file.writeBlocks(blocks.size() - 1, [&](size_t b, std::string *text) {
+        for (size_t j = blocks[b]; j < blocks[b + 1]; j++) {
+            std::string col = std::to_string(j + 1);
+            matrix.columns[j].forEach([&](int row, double value) {
+                if (value == 0) {
+                    return;
+                }
+                appendInteger(text, row + 1);
+                *text += ' ';
+                *text += col;
+                *text += ' ';
+                appendInteger(text, static_cast<size_t>(value));
+                *text += '\n';
+            });
+        }
+    });
+    stage.addNnz(nnz);
+}
+
+// Writes one line per name, where `format(i, &text)` appends line i (without
+// the newline).
+template <typename F>
+void writeNameLines(size_t size, OutputFile &file, F &&format) {
+    const size_t num_blocks = (size + kNamesPerBlock - 1) / kNamesPerBlock;
+    file.writeBlocks(num_blocks, [&](size_t b, std::string *text) {
+        const size_t end = std::min(size, (b + 1) * kNamesPerBlock);
+        for (size_t i = b * kNamesPerBlock; i < end; i++) {
+            format(i, text);
+            *text += '\n';
+        }
+    });
+}
+
+}  // namespace
+
+void MtxFileWriter::write(const SparseColumns &matrix,
+                          const MatrixNames &names, OutputFile &matrix_file,
+                          OutputFile &barcodes_file,
+                          OutputFile &features_file) {
+    ScopedStage stage("mtx");
+    checkNameCount(names.feature_ids, matrix.nrow, "feature IDs");
+    checkNameCount(names.feature_names, matrix.nrow, "feature names");
+    checkNameCount(names.barcodes, matrix.ncol, "barcodes");
+
+    writeEntries(matrix, matrix_file);
+
+    ScopedStage names_stage("write_names");
+    writeNameLines(names.barcodes.size(), barcodes_file,
+                   [&](size_t j, std::string *text) {
+                       text->append(names.barcodes[j]);
+                   });
+    writeNameLines(names.feature_ids.size(), features_file,
+                   [&](size_t i, std::string *text) {
+                       text->append(names.feature_ids[i]);
+                       *text += '\t';
+                       text->append(names.feature_names[i]);
+                       *text += '\t';
+                       *text += kFeatureType;
+                   });
+}
+
+}  // namespace smallcount
@@ -0,0 +1,27 @@
+#ifndef SMALLCOUNT_MTX_FILE_WRITER_H_
+#define SMALLCOUNT_MTX_FILE_WRITER_H_
+
+#include "matrix_names.h"
+#include "output_file.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+// File writer to store sparse matrices as .mtx files.
+class MtxFileWriter {
+   public:
+    // Writes the non-zero entries of a matrix to an .mtx file, in column-major
+    // order, and its features and barcodes to .tsv files (in the Cell Ranger
+    // v3 layout read by MtxFileReader).
+    static void write(const SparseColumns &matrix, const MatrixNames &names,
+                      OutputFile &matrix_file, OutputFile &barcodes_file,
+                      OutputFile &features_file);
+
+   private:
+    // Static class. Should not be instantiated.
+    MtxFileWriter() = default;
+};
+
+}  // namespace smallcount
+
+#endif
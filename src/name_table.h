@@ -0,0 +1,50 @@
+#ifndef SMALLCOUNT_NAME_TABLE_H_
+#define SMALLCOUNT_NAME_TABLE_H_
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace smallcount {
+
+// Table of names (e.g., barcodes or features) stored in a single contiguous
+// arena, avoiding one heap allocation per name.
+class NameTable {
+   public:
+    // Location of a name within the arena.
+    struct Span {
+        size_t offset;
+        size_t length;
+    };
+
+    NameTable() = default;
+    // Construct from a pre-filled arena (e.g., the raw contents of a file) and
+    // the locations of the names within it.
+    NameTable(std::string arena, std::vector<Span> spans)
+        : arena(std::move(arena)), spans(std::move(spans)) {}
+
+    // Appends a copy of a name to the end of the arena.
+    void append(std::string_view name) {
+        spans.push_back({arena.size(), name.size()});
+        arena.append(name);
+    }
+
+    size_t size() const { return spans.size(); }
+    // Size of the arena in bytes.
+    size_t bytes() const { return arena.size(); }
+    bool empty() const { return spans.empty(); }
+    std::string_view operator[](size_t i) const {
+        return std::string_view(arena.data() + spans[i].offset,
+                                spans[i].length);
+    }
+
+   private:
+    // Contiguous storage for all names.
+    std::string arena;
+    // Location of each name within the arena.
+    std::vector<Span> spans;
+};
+
+}  // namespace smallcount
+
+#endif
@@ -0,0 +1,98 @@
+#include "native_matrix.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "error.h"
+#include "profiler.h"
+#include "sparse_columns.h"
+#include "sparse_matrix.h"
+#include "sparse_sums.h"
+
+namespace smallcount {
+
+NativeMatrix::NativeMatrix(SvtSparseMatrix matrix) {
+    ScopedStage stage("native_matrix");
+    matrix.sortRowIndices();
+    view.nrow = matrix.metadata.nrow;
+    view.ncol = matrix.metadata.ncol;
+    col_ptr.assign(static_cast<size_t>(view.ncol) + 1, 0);
+    row_ind.reserve(matrix.metadata.nval);
+    values.reserve(matrix.metadata.nval);
+    for (int j = 0; j < view.ncol; j++) {
+        SvtEntry &entry = matrix.svt[j];
+        col_ptr[j] = row_ind.size();
+        row_ind.insert(row_ind.end(), entry[kSvtRowInd].begin(),
+                       entry[kSvtRowInd].end());
+        values.insert(values.end(), entry[kSvtValInd].begin(),
+                      entry[kSvtValInd].end());
+        // Release the column so that the peak memory is about one copy.
+        SvtEntry().swap(entry);
+    }
+    col_ptr[view.ncol] = row_ind.size();
+    stage.addNnz(nnz());
+    buildView();
+}
+
+NativeMatrix::NativeMatrix(const SparseColumns &columns) {
+    ScopedStage stage("native_matrix");
+    view.nrow = columns.nrow;
+    view.ncol = columns.ncol;
+    col_ptr.assign(static_cast<size_t>(view.ncol) + 1, 0);
+    row_ind.reserve(columns.nnz());
+    values.reserve(columns.nnz());
+    for (int j = 0; j < view.ncol; j++) {
+        col_ptr[j] = row_ind.size();
+        columns.columns[j].forEach([&](int row, double value) {
+            if (!isCount(value)) {
+                fail("Expected non-negative integer counts (got %g in column "
+                     "%d).",
+                     value, j + 1);
+            }
+            row_ind.push_back(row);
+            values.push_back(static_cast<int>(value));
+        });
+    }
+    col_ptr[view.ncol] = row_ind.size();
+    stage.addNnz(nnz());
+    buildView();
+}
+
+void NativeMatrix::buildView() {
+    view = columnsFromCsc(view.nrow, view.ncol, col_ptr.data(),
+                          row_ind.data(), values.data());
+}
+
+const std::vector<double> &NativeMatrix::colSums() {
+    if (!col_sums.has_value()) {
+        col_sums = smallcount::colSums(view);
+    }
+    return *col_sums;
+}
+
+const std::vector<double> &NativeMatrix::rowSums() {
+    if (!row_sums.has_value()) {
+        row_sums = smallcount::rowSums(view);
+    }
+    return *row_sums;
+}
+
+SvtSparseMatrix NativeMatrix::toSvt() const {
+    ScopedStage stage("to_svt");
+    stage.addNnz(nnz());
+    Svt svt(view.ncol, SvtEntry(2));
+    for (int j = 0; j < view.ncol; j++) {
+        const size_t start = col_ptr[j];
+        const size_t end = col_ptr[j + 1];
+        svt[j][kSvtRowInd].assign(row_ind.begin() + start,
+                                  row_ind.begin() + end);
+        svt[j][kSvtValInd].assign(values.begin() + start,
+                                  values.begin() + end);
+    }
+    MatrixMetadata metadata{.nrow = view.nrow, .ncol = view.ncol,
+                            .nval = nnz()};
+    return SvtSparseMatrix(std::move(svt), std::move(metadata));
+}
+
+}  // namespace smallcount
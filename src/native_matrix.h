@@ -0,0 +1,59 @@
+#ifndef SMALLCOUNT_NATIVE_MATRIX_H_
+#define SMALLCOUNT_NATIVE_MATRIX_H_
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "sparse_columns.h"
+#include "sparse_matrix.h"
+
+namespace smallcount {
+
+// Sparse count matrix owned by the core library and stored in one contiguous
+// CSC arena. It is kept alive between kernel calls (e.g., behind an R
+// external pointer), so that chained computations share a single copy of the
+// matrix, with its column and row sums computed once, and only convert it to
+// an SVT on demand. Names are left to the caller.
+class NativeMatrix {
+   public:
+    // Takes over the entries of an SVT, releasing each column once copied.
+    explicit NativeMatrix(SvtSparseMatrix matrix);
+    // Copies the entries of a sparse matrix view, whose values must be
+    // non-negative integer counts that fit in an int.
+    explicit NativeMatrix(const SparseColumns &view);
+
+    // The view points into the arena, which must not be copied.
+    NativeMatrix(const NativeMatrix &) = delete;
+    NativeMatrix &operator=(const NativeMatrix &) = delete;
+
+    int nrow() const { return view.nrow; }
+    int ncol() const { return view.ncol; }
+    size_t nnz() const { return row_ind.size(); }
+
+    // Column-major view of the arena, valid for the lifetime of the matrix.
+    const SparseColumns &columns() const { return view; }
+
+    // Column and row sums, computed on first use and cached.
+    const std::vector<double> &colSums();
+    const std::vector<double> &rowSums();
+
+    // Copies the entries to an SVT with sorted row indices and no names.
+    SvtSparseMatrix toSvt() const;
+
+   private:
+    // Points the column views into the arena.
+    void buildView();
+
+    std::vector<size_t> col_ptr;  // Offset of each column (size ncol + 1)
+    std::vector<int> row_ind;     // Row index of each non-zero entry
+    std::vector<int> values;      // Count of each non-zero entry
+    SparseColumns view;
+
+    std::optional<std::vector<double>> col_sums;
+    std::optional<std::vector<double>> row_sums;
+};
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_NATIVE_MATRIX_H_
@@ -0,0 +1,140 @@
+#include "output_file.h"
+
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "error.h"
+#include "name_table.h"
+#include "sparse_columns.h"
+#include "zlib.h"
+
+namespace smallcount {
+namespace {
+
+// zlib window bits of a zlib stream; adding 16 writes a gzip header instead.
+static constexpr int kWindowBits = 15;
+static constexpr int kGzipWindowBits = kWindowBits + 16;
+
+}  // namespace
+
+bool deflateBlock(const char *data, size_t size, bool gzip,
+                  std::string *compressed) {
+    z_stream stream{};
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                     gzip ? kGzipWindowBits : kWindowBits, /*memLevel=*/8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    compressed->assign(deflateBound(&stream, size), '\0');
+    stream.next_in =
+        reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    stream.avail_in = size;
+    stream.next_out = reinterpret_cast<Bytef *>(compressed->data());
+    stream.avail_out = compressed->size();
+    const int status = deflate(&stream, Z_FINISH);
+    compressed->resize(stream.total_out);
+    deflateEnd(&stream);
+    return status == Z_STREAM_END;
+}
+
+OutputFile::OutputFile(const std::string &filepath, bool gzip)
+    : filepath(filepath),
+      file(filepath, std::ios::binary | std::ios::trunc),
+      gzip(gzip) {
+    if (!file.is_open()) {
+        fail("Could not open file for writing: %s", filepath);
+    }
+}
+
+void OutputFile::write(std::string text) {
+    if (!finishBlock(text)) {
+        failCompression();
+    }
+    append(text);
+}
+
+void OutputFile::close() {
+    file.close();
+    if (file.fail()) {
+        fail("Could not write file: %s", filepath);
+    }
+}
+
+bool OutputFile::finishBlock(std::string &text) const {
+    if (!gzip || text.empty()) {
+        return true;
+    }
+    std::string compressed;
+    if (!deflateBlock(text.data(), text.size(), /*gzip=*/true, &compressed)) {
+        return false;
+    }
+    text = std::move(compressed);
+    return true;
+}
+
+void OutputFile::append(const std::string &block) {
+    file.write(block.data(), block.size());
+    bytes_written += block.size();
+}
+
+void OutputFile::failCompression() const {
+    fail("Could not compress a block of file: %s", filepath);
+}
+
+std::vector<size_t> countNonZeros(const SparseColumns &view) {
+    std::vector<size_t> counts(view.ncol, 0);
+    bool invalid = false;
+#pragma omp parallel for schedule(dynamic, 64) reduction(|| : invalid)
+    for (int j = 0; j < view.ncol; j++) {
+        size_t count = 0;
+        view.columns[j].forEach([&](int, double value) {
+            invalid = invalid || !isCount(value);
+            count += value != 0;
+        });
+        counts[j] = count;
+    }
+    if (!invalid) {
+        return counts;
+    }
+    // Report the first invalid value.
+    for (int j = 0; j < view.ncol; j++) {
+        view.columns[j].forEach([&](int, double value) {
+            if (!isCount(value)) {
+                fail("Expected non-negative integer counts (got %g in column "
+                     "%d).",
+                     value, j + 1);
+            }
+        });
+    }
+    return counts;
+}
+
+std::vector<size_t> splitBlocks(const std::vector<size_t> &counts,
+                                size_t target) {
+    std::vector<size_t> boundaries = {0};
+    size_t entries = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        entries += counts[i];
+        if (entries >= target) {
+            boundaries.push_back(i + 1);
+            entries = 0;
+        }
+    }
+    if (boundaries.back() != counts.size()) {
+        boundaries.push_back(counts.size());
+    }
+    return boundaries;
+}
+
+void checkNameCount(const NameTable &names, size_t expected,
+                    std::string_view what) {
+    if (names.size() != expected) {
+        fail("Expected %zu %s (got %zu).", expected, std::string(what),
+             names.size());
+    }
+}
+
+}  // namespace smallcount
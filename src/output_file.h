@@ -0,0 +1,114 @@
+#ifndef SMALLCOUNT_OUTPUT_FILE_H_
+#define SMALLCOUNT_OUTPUT_FILE_H_
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "name_table.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+// Compresses a block of bytes with zlib's deflate into `compressed`, as a
+// complete gzip member if `gzip` is true or as a zlib stream (e.g., an HDF5
+// deflate chunk) otherwise. Returns false if zlib fails. Does not throw, so it
+// can be called in parallel regions, whose callers fail after the region.
+bool deflateBlock(const char *data, size_t size, bool gzip,
+                  std::string *compressed);
+
+// Text file written in blocks that are formatted, and optionally gzipped, in
+// parallel, then appended in order. A gzipped file is a concatenation of
+// independent gzip members (one per block), which gzip, zlib and R read as a
+// single stream.
+class OutputFile {
+   public:
+    // Opens (and truncates) the file.
+    OutputFile(const std::string &filepath, bool gzip);
+
+    // Appends `text` as its own block.
+    void write(std::string text);
+
+    // Appends `num_blocks` blocks, where `format(i, &text)` appends the text
+    // of block i. Blocks are formatted in parallel, in batches that bound the
+    // memory held by formatted text.
+    template <typename F>
+    void writeBlocks(size_t num_blocks, F &&format);
+
+    // Flushes and closes the file, failing if any write failed.
+    void close();
+
+    // Bytes written to the file so far (after compression).
+    size_t bytesWritten() const { return bytes_written; }
+
+   private:
+    // Blocks formatted at once, per batch.
+    static constexpr size_t kBlocksPerBatch = 64;
+
+    // Compresses the block if needed (called in parallel). Returns false if
+    // the block could not be compressed.
+    bool finishBlock(std::string &text) const;
+    // Appends a finished block to the file.
+    void append(const std::string &block);
+    // Fails after a block could not be compressed.
+    [[noreturn]] void failCompression() const;
+
+    std::string filepath;
+    std::ofstream file;
+    bool gzip;
+    size_t bytes_written = 0;
+};
+
+template <typename F>
+void OutputFile::writeBlocks(size_t num_blocks, F &&format) {
+    std::vector<std::string> batch;
+    for (size_t start = 0; start < num_blocks; start += kBlocksPerBatch) {
+        const size_t batch_size = std::min(kBlocksPerBatch, num_blocks - start);
+        batch.assign(batch_size, std::string());
+        bool failed = false;
+#pragma omp parallel for schedule(dynamic, 1) reduction(|| : failed)
+        for (size_t b = 0; b < batch_size; b++) {
+            format(start + b, &batch[b]);
+            if (!finishBlock(batch[b])) {
+                failed = true;
+            }
+        }
+        if (failed) {
+            failCompression();
+        }
+        for (const std::string &block : batch) {
+            append(block);
+        }
+    }
+}
+
+// Appends the decimal representation of a non-negative integer.
+inline void appendInteger(std::string *text, size_t value) {
+    char buffer[24];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    text->append(buffer, result.ptr);
+}
+
+// Number of non-zero entries of each column, for the writers that store the
+// matrix in sparse form. Explicitly stored zeros are skipped by the writers.
+// Fails unless all values are non-negative integer counts that fit in an int.
+std::vector<size_t> countNonZeros(const SparseColumns &view);
+
+// Splits [0, counts.size()) into ranges of consecutive items (e.g., columns
+// or rows) holding about `target` entries each, per the entries of each item
+// in `counts`. Returns the range boundaries, starting at 0 and ending at
+// counts.size().
+std::vector<size_t> splitBlocks(const std::vector<size_t> &counts,
+                                size_t target);
+
+// Checks that a table has one name per row or column.
+void checkNameCount(const NameTable &names, size_t expected,
+                    std::string_view what);
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_OUTPUT_FILE_H_
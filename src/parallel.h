@@ -0,0 +1,30 @@
+#ifndef SMALLCOUNT_PARALLEL_H_
+#define SMALLCOUNT_PARALLEL_H_
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace smallcount {
+
+// Number of threads in the current OpenMP team (1 without OpenMP).
+inline int threadCount() {
+#ifdef _OPENMP
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
+
+// Index of the calling thread in the current OpenMP team (0 without OpenMP).
+inline int threadIndex() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_PARALLEL_H_
@@ -0,0 +1,129 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <string_view>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace smallcount {
+namespace {
+
+constexpr double kUnavailable = std::numeric_limits<double>::quiet_NaN();
+
+// State of the allocation hooks.
+std::atomic<bool> hooks_installed{false};
+std::atomic<size_t> hook_in_use{0};
+std::atomic<size_t> hook_peak{0};
+std::atomic<size_t> hook_count{0};
+
+bool hooksInstalled() {
+    return hooks_installed.load(std::memory_order_relaxed);
+}
+
+// Heap bytes currently in use, or NaN if they cannot be measured.
+double heapInUse() {
+    if (hooksInstalled()) {
+        return hook_in_use.load(std::memory_order_relaxed);
+    }
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const struct mallinfo2 info = mallinfo2();
+    return static_cast<double>(info.uordblks + info.hblkhd);
+#else
+    return kUnavailable;
+#endif
+}
+
+// Number of heap allocations so far, or NaN if they are not counted.
+double allocationCount() {
+    if (!hooksInstalled()) {
+        return kUnavailable;
+    }
+    return hook_count.load(std::memory_order_relaxed);
+}
+
+}  // namespace
+
+ScopedStage::ScopedStage(std::string_view name)
+    : profiler(Profiler::active()) {
+    if (profiler == nullptr) {
+        return;
+    }
+    record_index = profiler->stage_records.size();
+    StageRecord record;
+    record.name = std::string(name);
+    record.depth = profiler->open_peaks.size();
+    profiler->stage_records.push_back(std::move(record));
+
+    start_heap = heapInUse();
+    start_allocations = allocationCount();
+    if (hooksInstalled()) {
+        // Track the peak of this stage separately from the enclosing ones.
+        outer_hook_peak = hook_peak.exchange(
+            hook_in_use.load(std::memory_order_relaxed));
+    }
+    for (double &peak : profiler->open_peaks) {
+        peak = std::fmax(peak, start_heap);
+    }
+    profiler->open_peaks.push_back(start_heap);
+    start_time = std::chrono::steady_clock::now();
+}
+
+ScopedStage::~ScopedStage() {
+    if (profiler == nullptr ||
+        record_index >= profiler->stage_records.size()) {
+        return;
+    }
+    const auto end_time = std::chrono::steady_clock::now();
+    const double end_heap = heapInUse();
+
+    // Without hooks, the peak is only sampled at stage boundaries.
+    double peak = std::fmax(profiler->open_peaks.back(), end_heap);
+    profiler->open_peaks.pop_back();
+    if (hooksInstalled()) {
+        const size_t stage_peak = hook_peak.load(std::memory_order_relaxed);
+        hook_peak.store(std::max<size_t>(outer_hook_peak, stage_peak));
+        peak = stage_peak;
+    }
+    for (double &outer_peak : profiler->open_peaks) {
+        outer_peak = std::fmax(outer_peak, peak);
+    }
+
+    StageRecord &record = profiler->stage_records[record_index];
+    record.seconds =
+        std::chrono::duration<double>(end_time - start_time).count();
+    record.bytes_read = bytes_read;
+    record.nnz = nnz;
+    record.allocations = allocationCount() - start_allocations;
+    record.heap_delta = end_heap - start_heap;
+    record.peak_heap = peak;
+}
+
+namespace internal {
+
+void noteAllocation(size_t bytes) {
+    hooks_installed.store(true, std::memory_order_relaxed);
+    hook_count.fetch_add(1, std::memory_order_relaxed);
+    const size_t in_use =
+        hook_in_use.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = hook_peak.load(std::memory_order_relaxed);
+    while (in_use > peak &&
+           !hook_peak.compare_exchange_weak(peak, in_use,
+                                            std::memory_order_relaxed)) {
+    }
+}
+
+void noteDeallocation(size_t bytes) {
+    hook_in_use.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+}  // namespace internal
+
+}  // namespace smallcount
@@ -0,0 +1,84 @@
+#ifndef SMALLCOUNT_PROFILER_H_
+#define SMALLCOUNT_PROFILER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace smallcount {
+
+// Measurements of a named stage of a computation. Metrics that cannot be
+// measured on the current platform are NaN.
+struct StageRecord {
+    std::string name;
+    int depth = 0;           // Nesting depth (0 for top-level stages)
+    double seconds = 0;      // Wall time
+    double bytes_read = 0;   // Bytes read from input files
+    double nnz = 0;          // Non-zero entries processed
+    double allocations = 0;  // Number of heap allocations
+    double heap_delta = 0;   // Change in heap bytes in use
+    double peak_heap = 0;    // Peak heap bytes in use
+};
+
+// Collects a StageRecord for every ScopedStage created while it is active.
+// Stages must only be created from the main thread.
+class Profiler {
+   public:
+    // Returns the active profiler, or nullptr if profiling is disabled.
+    static Profiler *active() { return active_profiler; }
+    // Activates a profiler (or disables profiling if `profiler` is null).
+    static void setActive(Profiler *profiler) { active_profiler = profiler; }
+
+    // Records in the order in which the stages started.
+    const std::vector<StageRecord> &records() const { return stage_records; }
+
+   private:
+    friend class ScopedStage;
+
+    static inline Profiler *active_profiler = nullptr;
+
+    std::vector<StageRecord> stage_records;
+    // Peak heap observed so far by each open stage (innermost last).
+    std::vector<double> open_peaks;
+};
+
+// Records a stage for its lifetime if a profiler is active, and does nothing
+// otherwise. Counters are accumulated locally and reported when the stage
+// ends, so callers should add them in bulk rather than per entry.
+class ScopedStage {
+   public:
+    explicit ScopedStage(std::string_view name);
+    ~ScopedStage();
+    ScopedStage(const ScopedStage &) = delete;
+    ScopedStage &operator=(const ScopedStage &) = delete;
+
+    void addBytesRead(size_t bytes) { bytes_read += bytes; }
+    void addNnz(size_t count) { nnz += count; }
+
+   private:
+    Profiler *profiler;
+    size_t record_index = 0;
+    std::chrono::steady_clock::time_point start_time;
+    size_t bytes_read = 0;
+    size_t nnz = 0;
+    double start_heap = 0;
+    double start_allocations = 0;
+    double outer_hook_peak = 0;
+};
+
+namespace internal {
+
+// Allocation hooks for executables that replace the global operator new and
+// delete (e.g., the microbenchmark). Once called, allocation counts and exact
+// peaks are reported; otherwise heap usage is sampled from the allocator at
+// stage boundaries where possible.
+void noteAllocation(size_t bytes);
+void noteDeallocation(size_t bytes);
+
+}  // namespace internal
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_PROFILER_H_
@@ -0,0 +1,60 @@
+#include "qc_metrics.h"
+
+#include <algorithm>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "name_table.h"
+
+namespace smallcount {
+
+QcMetrics::QcMetrics(const std::string &mito_pattern)
+    : mito_regex(mito_pattern, std::regex::ECMAScript | std::regex::icase) {}
+
+void QcMetrics::resize(int nrow, int ncol) {
+    row_sums.assign(nrow, 0);
+    row_detected.assign(nrow, 0);
+    is_mito.assign(nrow, false);
+    col_sums.assign(ncol, 0);
+    col_detected.assign(ncol, 0);
+    col_mito_sums.assign(ncol, 0);
+}
+
+void QcMetrics::flagMitoFeatures(const NameTable &features) {
+    const size_t nrow = std::min(features.size(), is_mito.size());
+    for (size_t i = 0; i < nrow; i++) {
+        const std::string_view feature = features[i];
+        is_mito[i] =
+            std::regex_search(feature.begin(), feature.end(), mito_regex);
+    }
+}
+
+void QcMetrics::addRow(std::string_view feature) {
+    row_sums.emplace_back(0);
+    row_detected.emplace_back(0);
+    is_mito.emplace_back(
+        std::regex_search(feature.begin(), feature.end(), mito_regex));
+}
+
+std::vector<double> QcMetrics::mitoFraction() const {
+    std::vector<double> mito_fraction(col_sums.size());
+    for (size_t i = 0; i < col_sums.size(); i++) {
+        mito_fraction[i] =
+            col_sums[i] == 0 ? 0 : col_mito_sums[i] / col_sums[i];
+    }
+    return mito_fraction;
+}
+
+std::vector<double> QcMetrics::detectionRate() const {
+    const size_t ncol = col_sums.size();
+    std::vector<double> detection_rate(row_detected.size());
+    for (size_t i = 0; i < row_detected.size(); i++) {
+        detection_rate[i] =
+            ncol == 0 ? 0 : static_cast<double>(row_detected[i]) / ncol;
+    }
+    return detection_rate;
+}
+
+}  // namespace smallcount
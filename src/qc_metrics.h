@@ -0,0 +1,69 @@
+#ifndef SMALLCOUNT_QC_METRICS_H_
+#define SMALLCOUNT_QC_METRICS_H_
+
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "name_table.h"
+
+namespace smallcount {
+
+// Per-row and per-column quality control metrics, accumulated by the file
+// readers while they fill the SVT so that no further passes over the matrix
+// are needed.
+class QcMetrics {
+   public:
+    // Mitochondrial features are identified by a case-insensitive regular
+    // expression matched against the feature names.
+    explicit QcMetrics(const std::string &mito_pattern);
+
+    // Sizes the accumulators for a matrix with the given dimensions.
+    void resize(int nrow, int ncol);
+
+    // Flags the rows whose feature names match the mitochondrial pattern.
+    void flagMitoFeatures(const NameTable &features);
+
+    // Appends a row for readers that discover rows incrementally, flagging it
+    // if its feature name matches the mitochondrial pattern.
+    void addRow(std::string_view feature);
+
+    // Records a non-zero entry (0-based row and column indices). The indices
+    // are not checked: the readers validate them against the dimensions.
+    void add(int row, int col, double val) {
+        row_sums[row] += val;
+        row_detected[row]++;
+        col_sums[col] += val;
+        col_detected[col]++;
+        if (is_mito[row]) {
+            col_mito_sums[col] += val;
+        }
+    }
+
+    // Per-column metrics.
+    const std::vector<double> &colSums() const { return col_sums; }
+    const std::vector<int> &colDetected() const { return col_detected; }
+    // Fraction of each column's total count in mitochondrial rows.
+    std::vector<double> mitoFraction() const;
+
+    // Per-row metrics.
+    const std::vector<double> &rowSums() const { return row_sums; }
+    const std::vector<int> &rowDetected() const { return row_detected; }
+    // Fraction of columns in which each row is non-zero.
+    std::vector<double> detectionRate() const;
+
+   private:
+    std::regex mito_regex;
+
+    std::vector<double> row_sums;       // Total count of each row
+    std::vector<int> row_detected;      // Non-zero count of each row
+    std::vector<bool> is_mito;          // Whether each row is mitochondrial
+    std::vector<double> col_sums;       // Total count of each column
+    std::vector<int> col_detected;      // Non-zero count of each column
+    std::vector<double> col_mito_sums;  // Mitochondrial count of each column
+};
+
+}  // namespace smallcount
+
+#endif
@@ -0,0 +1,461 @@
+#include "rcpp_adapters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Rcpp.h"
+#include "csc_matrix.h"
+#include "csr_index.h"
+#include "file_reader.h"
+#include "gene_summaries.h"
+#include "group_deviance.h"
+#include "gram.h"
+#include "knn_graph.h"
+#include "name_table.h"
+#include "native_matrix.h"
+#include "profiler.h"
+#include "qc_metrics.h"
+#include "residual_matrix.h"
+#include "residuals.h"
+#include "sparse_columns.h"
+#include "sparse_matrix.h"
+
+using namespace Rcpp;
+
+namespace smallcount {
+namespace {
+
+static constexpr char kSvtSparseMatrix[] = "SVT_SparseMatrix";
+static constexpr char kNativeSparseMatrix[] = "NativeSparseMatrix";
+
+static constexpr char kSvt[] = "SVT";
+static constexpr char kSvtVersion[] = ".svt_version";
+static constexpr char kType[] = "type";
+static constexpr char kDim[] = "dim";
+static constexpr char kDimNames[] = "dimnames";
+
+// Slots of a CsparseMatrix (e.g., a dgCMatrix).
+static constexpr char kColPtr[] = "p";
+static constexpr char kRowInd[] = "i";
+static constexpr char kValues[] = "x";
+static constexpr char kCsparseDim[] = "Dim";
+
+// Slot of a NativeSparseMatrix holding the external pointer to the matrix.
+static constexpr char kPtr[] = "ptr";
+
+// Tag of the external pointers to a ResidualMatrix.
+static constexpr char kResidualMatrix[] = "ResidualMatrix";
+
+// Attribute of a matrix holding its cached row index.
+static constexpr char kRowIndex[] = "row_index";
+
+static constexpr int kVersionNum = 1;
+static constexpr char kInteger[] = "integer";
+
+List createDimNamesList(const NameTable &row_names,
+                        const NameTable &col_names) {
+    List dim_names = List(2);
+    if (!row_names.empty()) {
+        dim_names[0] = toRcpp(row_names);
+    }
+    if (!col_names.empty()) {
+        dim_names[1] = toRcpp(col_names);
+    }
+    return dim_names;
+}
+
+// Converts the C++ SVT matrix to an Rcpp List.
+List createSvtList(Svt svt) {
+    const int ncol = svt.size();
+    List svt_list = List(ncol);
+    for (int i = 0; i < ncol; i++) {
+        if (!svt[i][0].empty()) {
+            svt_list[i] = wrap(std::move(svt[i]));
+        }
+    }
+    return svt_list;
+}
+
+// Whether two views point to the same column storage.
+bool sameColumns(const std::vector<SparseColumn> &columns,
+                 const SparseColumns &view) {
+    if (columns.size() != view.columns.size()) {
+        return false;
+    }
+    for (size_t j = 0; j < columns.size(); j++) {
+        const SparseColumn &a = columns[j];
+        const SparseColumn &b = view.columns[j];
+        if (a.rows != b.rows || a.int_values != b.int_values ||
+            a.float_values != b.float_values ||
+            a.real_values != b.real_values || a.nnz != b.nnz) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether the values of a view are stored as float.
+bool floatValues(const SparseColumns &view) {
+    return std::all_of(view.columns.begin(), view.columns.end(),
+                       [](const SparseColumn &column) {
+                           return column.nnz == 0 ||
+                                  column.float_values != nullptr;
+                       });
+}
+
+// Calls `f(residuals)` with a view of the residuals of a sparse matrix view.
+// Identity residuals are the values of the view itself, so they are only
+// copied to store them as float (unless they already are, e.g., when the
+// view is a ResidualMatrix).
+template <typename F>
+void withResiduals(const SparseColumns &view, const ResidualParams &params,
+                   Precision precision, F &&f) {
+    if (params.type == ResidualType::kIdentity &&
+        (precision == Precision::kDouble || floatValues(view))) {
+        f(view);
+        return;
+    }
+    const ResidualMatrix residuals(view, params, precision);
+    f(residuals.columns());
+}
+
+}  // namespace
+
+SEXP toRcpp(const NameTable &names) {
+    SEXP strings = PROTECT(Rf_allocVector(STRSXP, names.size()));
+    for (size_t i = 0; i < names.size(); i++) {
+        const std::string_view name = names[i];
+        SET_STRING_ELT(strings, i,
+                       Rf_mkCharLenCE(name.data(), name.size(), CE_UTF8));
+    }
+    UNPROTECT(1);
+    return strings;
+}
+
+NameTable namesFromRcpp(const CharacterVector &names) {
+    NameTable table;
+    for (R_xlen_t i = 0; i < names.size(); i++) {
+        SEXP name = STRING_ELT(names, i);
+        if (name != NA_STRING) {
+            table.append(std::string_view(CHAR(name), LENGTH(name)));
+        } else {
+            table.append("");
+        }
+    }
+    return table;
+}
+
+SEXP toRcpp(SvtSparseMatrix matrix) {
+    {
+        ScopedStage stage("sort_row_indices");
+        matrix.sortRowIndices();
+        stage.addNnz(matrix.metadata.nval);
+    }
+    S4 obj(kSvtSparseMatrix);
+    obj.slot(kSvt) = R_NilValue;
+    if (matrix.metadata.nval != 0) {
+        obj.slot(kSvt) = createSvtList(std::move(matrix.svt));
+    }
+    obj.slot(kDim) =
+        IntegerVector({matrix.metadata.nrow, matrix.metadata.ncol});
+    obj.slot(kDimNames) = createDimNamesList(matrix.metadata.row_names,
+                                             matrix.metadata.col_names);
+    obj.slot(kType) = kInteger;
+    obj.slot(kSvtVersion) = kVersionNum;
+    return obj;
+}
+
+List toRcpp(const QcMetrics &qc) {
+    DataFrame col_qc =
+        DataFrame::create(_["sum"] = wrap(qc.colSums()),
+                          _["detected"] = wrap(qc.colDetected()),
+                          _["mito_fraction"] = wrap(qc.mitoFraction()));
+    DataFrame row_qc =
+        DataFrame::create(_["sum"] = wrap(qc.rowSums()),
+                          _["detected"] = wrap(qc.rowDetected()),
+                          _["detection_rate"] = wrap(qc.detectionRate()));
+    return List::create(_["col"] = col_qc, _["row"] = row_qc);
+}
+
+DataFrame toRcpp(const GeneSummaries &summaries) {
+    return DataFrame::create(_["sum"] = wrap(summaries.sum),
+                             _["mean"] = wrap(summaries.mean),
+                             _["variance"] = wrap(summaries.variance),
+                             _["detected"] = wrap(summaries.detected),
+                             _["deviance"] = wrap(summaries.deviance),
+                             _["dispersion"] = wrap(summaries.dispersion));
+}
+
+List toRcpp(const GroupDeviance &stats) {
+    const auto to_matrix = [&stats](const std::vector<double> &values) {
+        NumericMatrix matrix(stats.nrow, stats.num_groups);
+        std::copy(values.begin(), values.end(), matrix.begin());
+        return matrix;
+    };
+    return List::create(_["rate"] = to_matrix(stats.rates),
+                        _["deviance"] = to_matrix(stats.deviance),
+                        _["lrt"] = to_matrix(stats.lrt));
+}
+
+List toRcpp(const KnnGraph &graph) {
+    const int n = graph.num_points;
+    const int k = graph.k;
+    IntegerMatrix index(n, k);
+    NumericMatrix distance(n, k);
+    Svt svt(n, SvtEntry(2));
+    for (int i = 0; i < n; i++) {
+        SvtEntry &column = svt[i];
+        column[kSvtRowInd].reserve(k);
+        column[kSvtValInd].assign(k, 1);
+        for (int s = 0; s < k; s++) {
+            const size_t p = static_cast<size_t>(i) * k + s;
+            index(i, s) = graph.indices[p] + 1;
+            distance(i, s) = graph.distances[p];
+            column[kSvtRowInd].push_back(graph.indices[p]);
+        }
+    }
+    MatrixMetadata metadata{.nrow = n, .ncol = n,
+                            .nval = static_cast<size_t>(n) * k};
+    return List::create(
+        _["index"] = index, _["distance"] = distance,
+        _["graph"] =
+            toRcpp(SvtSparseMatrix(std::move(svt), std::move(metadata))));
+}
+
+SEXP toRcpp(ReadResult result) {
+    ScopedStage stage("to_rcpp");
+    stage.addNnz(result.matrix.metadata.nval);
+    if (!result.qc.has_value()) {
+        return toRcpp(std::move(result.matrix));
+    }
+    return List::create(_["matrix"] = toRcpp(std::move(result.matrix)),
+                        _["qc"] = toRcpp(*result.qc));
+}
+
+SEXP toRcppNative(ReadResult result) {
+    ScopedStage stage("to_rcpp");
+    stage.addNnz(result.matrix.metadata.nval);
+    const List dim_names = createDimNamesList(
+        result.matrix.metadata.row_names, result.matrix.metadata.col_names);
+    SEXP matrix = toRcpp(
+        std::make_unique<NativeMatrix>(std::move(result.matrix)), dim_names);
+    if (!result.qc.has_value()) {
+        return matrix;
+    }
+    return List::create(_["matrix"] = matrix, _["qc"] = toRcpp(*result.qc));
+}
+
+SEXP toRcpp(std::unique_ptr<NativeMatrix> matrix, SEXP dim_names) {
+    S4 obj(kNativeSparseMatrix);
+    obj.slot(kDim) = IntegerVector({matrix->nrow(), matrix->ncol()});
+    obj.slot(kDimNames) = dim_names;
+    // The tag identifies the pointer as a NativeMatrix when it is read back.
+    obj.slot(kPtr) = XPtr<NativeMatrix>(matrix.release(), /*set_delete=*/true,
+                                        Rf_install(kNativeSparseMatrix));
+    return obj;
+}
+
+SEXP svtFromNative(SEXP matrix) {
+    const NativeMatrix *native = nativeFromRcpp(matrix);
+    if (native == nullptr) {
+        stop("Expected a NativeSparseMatrix.");
+    }
+    S4 obj(toRcpp(native->toSvt()));
+    obj.slot(kDimNames) = R_do_slot(matrix, Rf_install(kDimNames));
+    return obj;
+}
+
+NativeMatrix *nativeFromRcpp(SEXP matrix) {
+    if (!Rf_inherits(matrix, kNativeSparseMatrix)) {
+        return nullptr;
+    }
+    const SEXP ptr = R_do_slot(matrix, Rf_install(kPtr));
+    if (TYPEOF(ptr) != EXTPTRSXP ||
+        R_ExternalPtrTag(ptr) != Rf_install(kNativeSparseMatrix)) {
+        stop("Invalid NativeSparseMatrix: its ptr slot does not hold a native "
+             "matrix.");
+    }
+    NativeMatrix *native = XPtr<NativeMatrix>(ptr).get();
+    if (native == nullptr) {
+        stop("The NativeSparseMatrix is no longer valid (external pointers "
+             "do not survive saving and restoring).");
+    }
+    return native;
+}
+
+SEXP toRcpp(std::unique_ptr<ResidualMatrix> residuals) {
+    // The tag identifies the pointer as a ResidualMatrix when it is read back.
+    return XPtr<ResidualMatrix>(residuals.release(), /*set_delete=*/true,
+                                Rf_install(kResidualMatrix));
+}
+
+ResidualMatrix *residualsFromRcpp(SEXP ptr) {
+    if (TYPEOF(ptr) != EXTPTRSXP) {
+        return nullptr;
+    }
+    if (R_ExternalPtrTag(ptr) != Rf_install(kResidualMatrix)) {
+        stop("Invalid external pointer: expected residuals.");
+    }
+    ResidualMatrix *residuals = XPtr<ResidualMatrix>(ptr).get();
+    if (residuals == nullptr) {
+        stop("The residuals are no longer valid (external pointers do not "
+             "survive saving and restoring).");
+    }
+    return residuals;
+}
+
+DataFrame toRcpp(const std::vector<StageRecord> &records) {
+    const size_t num_records = records.size();
+    CharacterVector stage(num_records);
+    IntegerVector depth(num_records);
+    NumericVector seconds(num_records), bytes_read(num_records),
+        nnz(num_records), allocations(num_records), heap_delta(num_records),
+        peak_heap(num_records);
+    const auto na_if_nan = [](double x) {
+        return std::isnan(x) ? NA_REAL : x;
+    };
+    for (size_t i = 0; i < num_records; i++) {
+        const StageRecord &record = records[i];
+        stage[i] = record.name;
+        depth[i] = record.depth;
+        seconds[i] = record.seconds;
+        bytes_read[i] = record.bytes_read;
+        nnz[i] = record.nnz;
+        allocations[i] = na_if_nan(record.allocations);
+        heap_delta[i] = na_if_nan(record.heap_delta);
+        peak_heap[i] = na_if_nan(record.peak_heap);
+    }
+    return DataFrame::create(
+        _["stage"] = stage, _["depth"] = depth, _["seconds"] = seconds,
+        _["bytes_read"] = bytes_read, _["nnz"] = nnz,
+        _["allocations"] = allocations, _["heap_delta"] = heap_delta,
+        _["peak_heap"] = peak_heap, _["stringsAsFactors"] = false);
+}
+
+SparseColumns columnsFromRcpp(SEXP matrix) {
+    if (const NativeMatrix *native = nativeFromRcpp(matrix)) {
+        return native->columns();
+    }
+    if (const ResidualMatrix *residuals = residualsFromRcpp(matrix)) {
+        return residuals->columns();
+    }
+    if (R_has_slot(matrix, Rf_install(kSvt))) {
+        const SEXP dim = R_do_slot(matrix, Rf_install(kDim));
+        SparseColumns view;
+        view.nrow = INTEGER(dim)[0];
+        view.ncol = INTEGER(dim)[1];
+        view.columns.resize(view.ncol);
+        const SEXP svt = R_do_slot(matrix, Rf_install(kSvt));
+        // NULL SVT (all zeros)
+        if (Rf_isNull(svt)) {
+            return view;
+        }
+        for (int j = 0; j < view.ncol; j++) {
+            const SEXP leaf = VECTOR_ELT(svt, j);
+            // NULL leaf (all zeros)
+            if (Rf_isNull(leaf)) {
+                continue;
+            }
+            const SEXP nz_rows = VECTOR_ELT(leaf, kSvtRowInd);
+            const SEXP nz_vals = VECTOR_ELT(leaf, kSvtValInd);
+            SparseColumn &column = view.columns[j];
+            column.rows = INTEGER(nz_rows);
+            column.nnz = XLENGTH(nz_rows);
+            if (TYPEOF(nz_vals) == REALSXP) {
+                column.real_values = REAL(nz_vals);
+            } else if (TYPEOF(nz_vals) == INTSXP ||
+                       TYPEOF(nz_vals) == LGLSXP) {
+                column.int_values = INTEGER(nz_vals);
+            }
+            // Lacunar leaves (all ones) store no values.
+        }
+        return view;
+    }
+
+    if (!R_has_slot(matrix, Rf_install(kColPtr))) {
+        stop("Expected an SVT_SparseMatrix or a CsparseMatrix.");
+    }
+    const SEXP dim = R_do_slot(matrix, Rf_install(kCsparseDim));
+    const int nrow = INTEGER(dim)[0];
+    const int ncol = INTEGER(dim)[1];
+    const int *col_ptr = INTEGER(R_do_slot(matrix, Rf_install(kColPtr)));
+    const int *row_ind = INTEGER(R_do_slot(matrix, Rf_install(kRowInd)));
+    // Pattern matrices (ngCMatrix) have no values.
+    if (!R_has_slot(matrix, Rf_install(kValues))) {
+        return columnsFromCsc<int>(nrow, ncol, col_ptr, row_ind, nullptr);
+    }
+    const SEXP values = R_do_slot(matrix, Rf_install(kValues));
+    if (TYPEOF(values) == REALSXP) {
+        return columnsFromCsc(nrow, ncol, col_ptr, row_ind, REAL(values));
+    }
+    return columnsFromCsc(nrow, ncol, col_ptr, row_ind, INTEGER(values));
+}
+
+SEXP rowIndexFromRcpp(SEXP matrix) {
+    SparseColumns view = columnsFromRcpp(matrix);
+    auto *cached = new CachedRowIndex{rowIndex(view), std::move(view.columns)};
+    // The tag identifies the pointer as a row index when it is read back.
+    return XPtr<CachedRowIndex>(cached, /*set_delete=*/true,
+                                Rf_install(kRowIndex), matrix);
+}
+
+const CsrIndex *cachedRowIndex(SEXP matrix, const SparseColumns &view) {
+    const SEXP attr = Rf_getAttrib(matrix, Rf_install(kRowIndex));
+    if (TYPEOF(attr) != EXTPTRSXP ||
+        R_ExternalPtrTag(attr) != Rf_install(kRowIndex)) {
+        return nullptr;
+    }
+    // The pointer is null if the matrix was serialized and restored.
+    const CachedRowIndex *cached = XPtr<CachedRowIndex>(attr).get();
+    if (cached == nullptr || cached->index.nrow != view.nrow ||
+        !sameColumns(cached->columns, view)) {
+        return nullptr;
+    }
+    return &cached->index;
+}
+
+NumericMatrix residualTcrossprod(const SparseColumns &view,
+                                 const ResidualParams &params,
+                                 Precision precision) {
+    NumericMatrix gram(view.nrow, view.nrow);
+    ScopedStage stage("tcrossprod");
+    withResiduals(view, params, precision, [&](const SparseColumns &r) {
+        tcrossprod(r, gram.begin());
+    });
+    return gram;
+}
+
+NumericMatrix residualCrossprod(const SparseColumns &view,
+                                const ResidualParams &params,
+                                const NumericMatrix &v, Precision precision) {
+    if (v.nrow() != view.nrow) {
+        stop("Non-conformable arguments (%d rows vs. %d).", v.nrow(),
+             view.nrow);
+    }
+    NumericMatrix result(view.ncol, v.ncol());
+    ScopedStage stage("crossprod");
+    withResiduals(view, params, precision, [&](const SparseColumns &r) {
+        crossprod(r, v.begin(), v.ncol(), result.begin());
+    });
+    return result;
+}
+
+NumericMatrix residualProd(const SparseColumns &view,
+                           const ResidualParams &params,
+                           const NumericMatrix &v, Precision precision) {
+    if (v.nrow() != view.ncol) {
+        stop("Non-conformable arguments (%d columns vs. %d rows).", view.ncol,
+             v.nrow());
+    }
+    NumericMatrix result(view.nrow, v.ncol());
+    ScopedStage stage("prod");
+    withResiduals(view, params, precision, [&](const SparseColumns &r) {
+        prod(r, v.begin(), v.ncol(), result.begin());
+    });
+    return result;
+}
+
+}  // namespace smallcount
@@ -0,0 +1,128 @@
+#ifndef SMALLCOUNT_RCPP_ADAPTERS_H_
+#define SMALLCOUNT_RCPP_ADAPTERS_H_
+
+#include <memory>
+#include <vector>
+
+#include "Rcpp.h"
+#include "csc_matrix.h"
+#include "csr_index.h"
+#include "file_reader.h"
+#include "gene_summaries.h"
+#include "group_deviance.h"
+#include "gram.h"
+#include "knn_graph.h"
+#include "name_table.h"
+#include "native_matrix.h"
+#include "profiler.h"
+#include "qc_metrics.h"
+#include "residual_matrix.h"
+#include "sparse_columns.h"
+#include "sparse_matrix.h"
+
+using namespace Rcpp;
+
+// Conversions between the Rcpp-free core library and R objects. Only this
+// layer (and exports.cpp) depends on Rcpp.
+
+namespace smallcount {
+
+// Converts names to a character vector in a single pass, without
+// materializing intermediate strings.
+SEXP toRcpp(const NameTable &names);
+
+// Copies a character vector into a NameTable. NA strings become empty names.
+NameTable namesFromRcpp(const CharacterVector &names);
+
+// Consumes the matrix and converts it to an SVT_SparseMatrix S4 object.
+SEXP toRcpp(SvtSparseMatrix matrix);
+
+// Converts the metrics to a List with a per-column ("col") and a per-row
+// ("row") data frame.
+List toRcpp(const QcMetrics &qc);
+
+// Converts the summaries to a data frame with one row per row of the matrix.
+DataFrame toRcpp(const GeneSummaries &summaries);
+
+// Converts the statistics to a List of nrow x num_groups matrices ("rate",
+// "deviance" and "lrt").
+List toRcpp(const GroupDeviance &stats);
+
+// Converts a kNN graph to a list with the 1-based neighbor indices and the
+// distances (points x k matrices) and the adjacency matrix as an
+// SVT_SparseMatrix, whose column j has ones at the neighbors of point j.
+List toRcpp(const KnnGraph &graph);
+
+// Consumes the result of reading a file and converts it to an S4 object,
+// paired with the QC metrics if they were requested.
+SEXP toRcpp(ReadResult result);
+
+// Consumes the result of reading a file and wraps the matrix in a
+// NativeSparseMatrix S4 object, paired with the QC metrics if they were
+// requested. Only the names are converted to R objects.
+SEXP toRcppNative(ReadResult result);
+
+// Wraps a matrix in a NativeSparseMatrix S4 object with the given dimnames.
+SEXP toRcpp(std::unique_ptr<NativeMatrix> matrix, SEXP dim_names);
+
+// Converts a NativeSparseMatrix S4 object to an SVT_SparseMatrix.
+SEXP svtFromNative(SEXP matrix);
+
+// Returns the matrix held by a NativeSparseMatrix S4 object, or null if
+// `matrix` is another type of matrix.
+NativeMatrix *nativeFromRcpp(SEXP matrix);
+
+// Wraps residuals in an external pointer, to be held by a NativeResiduals S4
+// object.
+SEXP toRcpp(std::unique_ptr<ResidualMatrix> residuals);
+
+// Returns the residuals held by an external pointer created by toRcpp(), or
+// null if `ptr` is not an external pointer.
+ResidualMatrix *residualsFromRcpp(SEXP ptr);
+
+// Converts stage records to a data frame with one row per stage. Unavailable
+// metrics are NA.
+DataFrame toRcpp(const std::vector<StageRecord> &records);
+
+// Views the columns of an SVT_SparseMatrix, a CsparseMatrix (e.g., a
+// dgCMatrix), a NativeSparseMatrix or the external pointer to a
+// ResidualMatrix without copying them. The view points into `matrix`, which
+// must outlive it.
+SparseColumns columnsFromRcpp(SEXP matrix);
+
+// Row index cached on an R matrix, with the column storage it was built from
+// so that the index of a matrix that has since been modified is not used.
+struct CachedRowIndex {
+    CsrIndex index;
+    std::vector<SparseColumn> columns;
+};
+
+// Builds the row index of an SVT_SparseMatrix or a CsparseMatrix as an
+// external pointer to be cached on the matrix. The pointer keeps the matrix
+// alive, so that the addresses of its storage are not reused while cached.
+SEXP rowIndexFromRcpp(SEXP matrix);
+
+// Returns the row index cached on `matrix` if it was built from the storage
+// viewed by `view`, or null otherwise.
+const CsrIndex *cachedRowIndex(SEXP matrix, const SparseColumns &view);
+
+// Computes `R %*% t(R)` (nrow x nrow) for the residual matrix R of a sparse
+// matrix.
+NumericMatrix residualTcrossprod(const SparseColumns &view,
+                                 const ResidualParams &params,
+                                 Precision precision);
+
+// Computes `t(R) %*% v` (ncol x k) for the residual matrix R of a sparse
+// matrix.
+NumericMatrix residualCrossprod(const SparseColumns &view,
+                                const ResidualParams &params,
+                                const NumericMatrix &v, Precision precision);
+
+// Computes `R %*% v` (nrow x k) for the residual matrix R of a sparse matrix.
+NumericMatrix residualProd(const SparseColumns &view,
+                           const ResidualParams &params,
+                           const NumericMatrix &v, Precision precision);
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_RCPP_ADAPTERS_H_
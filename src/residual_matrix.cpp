@@ -0,0 +1,71 @@
+#include "residual_matrix.h"
+
+#include <cmath>
+#include <vector>
+
+#include "csc_matrix.h"
+#include "gram.h"
+#include "profiler.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+namespace {
+
+template <typename T>
+void scaleValues(const double *scale, CscMatrix<T> *matrix) {
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int j = 0; j < matrix->ncol; j++) {
+        for (size_t p = matrix->col_ptr[j]; p < matrix->col_ptr[j + 1]; p++) {
+            matrix->values[p] = static_cast<T>(
+                matrix->values[p] / scale[matrix->row_ind[p]]);
+        }
+    }
+}
+
+}  // namespace
+
+ResidualMatrix::ResidualMatrix(const SparseColumns &counts,
+                               const ResidualParams &params,
+                               Precision precision) {
+    ScopedStage stage("residual_matrix");
+    stage.addNnz(counts.nnz());
+    if (precision == Precision::kFloat) {
+        floats = cscFromColumns<float>(counts);
+        applyResiduals(params, &floats);
+        view = columnsFromCsc(floats);
+    } else {
+        doubles = cscFromColumns<double>(counts);
+        applyResiduals(params, &doubles);
+        view = columnsFromCsc(doubles);
+    }
+}
+
+std::vector<double> ResidualMatrix::rowStandardDeviations() const {
+    std::vector<double> sums(view.nrow, 0);
+    std::vector<double> squares(view.nrow, 0);
+    for (const SparseColumn &column : view.columns) {
+        column.forEach([&](int row, double value) {
+            sums[row] += value;
+            squares[row] += value * value;
+        });
+    }
+    const double ncol = view.ncol;
+    std::vector<double> sd(view.nrow);
+    for (int i = 0; i < view.nrow; i++) {
+        sd[i] = std::sqrt((squares[i] - sums[i] * sums[i] / ncol) /
+                          (ncol - 1));
+    }
+    return sd;
+}
+
+void ResidualMatrix::scaleRows(const double *scale) {
+    ScopedStage stage("scale_rows");
+    stage.addNnz(view.nnz());
+    if (!floats.values.empty()) {
+        scaleValues(scale, &floats);
+    } else {
+        scaleValues(scale, &doubles);
+    }
+}
+
+}  // namespace smallcount
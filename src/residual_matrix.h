@@ -0,0 +1,45 @@
+#ifndef SMALLCOUNT_RESIDUAL_MATRIX_H_
+#define SMALLCOUNT_RESIDUAL_MATRIX_H_
+
+#include <vector>
+
+#include "csc_matrix.h"
+#include "gram.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+// Residuals of a sparse count matrix, computed once and stored in one
+// contiguous CSC arena of float or double values. Like a NativeMatrix, it is
+// kept alive between kernel calls (behind an R external pointer), so that the
+// products of an iterative computation share a single copy of the residuals
+// and no double precision copy is needed when they are stored as float.
+class ResidualMatrix {
+   public:
+    // Computes the residuals of the non-zero counts of a sparse matrix view.
+    ResidualMatrix(const SparseColumns &counts, const ResidualParams &params,
+                   Precision precision);
+
+    // The view points into the arena, which must not be copied.
+    ResidualMatrix(const ResidualMatrix &) = delete;
+    ResidualMatrix &operator=(const ResidualMatrix &) = delete;
+
+    // Column-major view of the residuals, valid for the lifetime of the
+    // matrix.
+    const SparseColumns &columns() const { return view; }
+
+    // Standard deviation of each row, including its zeros.
+    std::vector<double> rowStandardDeviations() const;
+
+    // Divides the residuals of each row by its scale (one per row).
+    void scaleRows(const double *scale);
+
+   private:
+    CscMatrix<float> floats;    // Residuals stored as float, or empty
+    CscMatrix<double> doubles;  // Residuals stored as double, or empty
+    SparseColumns view;
+};
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_RESIDUAL_MATRIX_H_
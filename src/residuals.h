@@ -0,0 +1,70 @@
+#ifndef SMALLCOUNT_RESIDUALS_H_
+#define SMALLCOUNT_RESIDUALS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace smallcount {
+
+// Transformations applied to the non-zero entries of a count matrix before
+// computing its principal components.
+enum class ResidualType {
+    kIdentity,  // y
+    kPearson,   // y / sqrt(mu)
+    kDeviance,  // sign(y - mu) * sqrt(deviance) + sqrt(2 * mu)
+    kLog1p,     // log1p(coef * y)
+};
+
+// Parses a residual type from its R name ("identity", "pearson", "deviance"
+// or "log1p"). Returns false if the name is not recognized.
+inline bool parseResidualType(const std::string &name, ResidualType *type) {
+    if (name == "identity") {
+        *type = ResidualType::kIdentity;
+    } else if (name == "pearson") {
+        *type = ResidualType::kPearson;
+    } else if (name == "deviance") {
+        *type = ResidualType::kDeviance;
+    } else if (name == "log1p") {
+        *type = ResidualType::kLog1p;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Whether a residual type depends on the Poisson model (rates and column
+// sums) of the counts.
+inline bool needsModel(ResidualType type) {
+    return type == ResidualType::kPearson || type == ResidualType::kDeviance;
+}
+
+// Transforms a non-zero count `y` with expected value `mu = rate * n`. The
+// log1p transform also takes a scale (see ResidualParams).
+//
+// The dense part of the residual (i.e., its value at y = 0) is a rank-one
+// matrix that is handled separately by the callers, so only the sparse part is
+// computed here. Features with a zero rate (e.g., never observed when a model
+// was fitted) have no residual.
+inline double residual(ResidualType type, double y, double rate, double n) {
+    if (needsModel(type) && rate == 0) {
+        return 0;
+    }
+    switch (type) {
+        case ResidualType::kPearson:
+            return y / std::sqrt(rate * n);
+        case ResidualType::kDeviance: {
+            const double mu = rate * n;
+            const double deviance =
+                std::max(2 * (y * std::log(y / mu) - y + mu), 0.0);
+            const double sign = y > mu ? 1 : (y < mu ? -1 : 0);
+            return sign * std::sqrt(deviance) + std::sqrt(2 * mu);
+        }
+        default:
+            return y;
+    }
+}
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_RESIDUALS_H_
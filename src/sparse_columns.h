@@ -0,0 +1,142 @@
+#ifndef SMALLCOUNT_SPARSE_COLUMNS_H_
+#define SMALLCOUNT_SPARSE_COLUMNS_H_
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "sparse_matrix.h"
+
+namespace smallcount {
+
+// Non-owning view of the non-zero entries of one column of a sparse matrix.
+// Values are stored as int (integer or logical), as float or double, or not at
+// all (lacunar or pattern columns, where every value is one).
+struct SparseColumn {
+    const int *rows = nullptr;
+    const int *int_values = nullptr;
+    const float *float_values = nullptr;
+    const double *real_values = nullptr;
+    size_t nnz = 0;
+
+    // Calls `f(value)` with a function returning the value of the p-th entry
+    // as a double, dispatching on the value storage once per column rather
+    // than once per entry.
+    template <typename F>
+    void withValues(F &&f) const {
+        if (real_values != nullptr) {
+            f([values = real_values](size_t p) { return values[p]; });
+        } else if (float_values != nullptr) {
+            f([values = float_values](size_t p) {
+                return static_cast<double>(values[p]);
+            });
+        } else if (int_values != nullptr) {
+            f([values = int_values](size_t p) {
+                return static_cast<double>(values[p]);
+            });
+        } else {
+            f([](size_t) { return 1.0; });
+        }
+    }
+
+    // Calls `f(row, value)` for each non-zero entry.
+    template <typename F>
+    void forEach(F &&f) const {
+        withValues([&](auto value) {
+            for (size_t p = 0; p < nnz; p++) {
+                f(rows[p], value(p));
+            }
+        });
+    }
+
+    // Calls `f(row, value)` for each non-zero entry whose row is in
+    // [row_begin, row_end). Rows are sorted within a column, so the first
+    // entry is found by binary search.
+    template <typename F>
+    void forEachInRows(int row_begin, int row_end, F &&f) const {
+        const size_t begin =
+            std::lower_bound(rows, rows + nnz, row_begin) - rows;
+        const size_t end =
+            std::lower_bound(rows + begin, rows + nnz, row_end) - rows;
+        withValues([&](auto value) {
+            for (size_t p = begin; p < end; p++) {
+                f(rows[p], value(p));
+            }
+        });
+    }
+};
+
+// Non-owning, column-major view of a sparse matrix whose storage lives
+// elsewhere: the leaves of an SVT, or the `p`, `i` and `x` arrays of a CSC
+// matrix (e.g., a dgCMatrix). The kernels take a view so that they run on
+// either representation without converting between them.
+struct SparseColumns {
+    int nrow = 0;
+    int ncol = 0;
+    std::vector<SparseColumn> columns;  // One per column
+
+    // Total number of non-zero entries.
+    size_t nnz() const {
+        size_t total = 0;
+        for (const SparseColumn &column : columns) {
+            total += column.nnz;
+        }
+        return total;
+    }
+};
+
+// Whether a value is a non-negative integer count that fits in an int.
+inline bool isCount(double value) {
+    return value >= 0 && value <= INT_MAX && value == std::round(value);
+}
+
+// Views the columns of an SVT, which must outlive the view.
+inline SparseColumns columnsFromSvt(const SvtSparseMatrix &matrix) {
+    SparseColumns view;
+    view.nrow = matrix.metadata.nrow;
+    view.ncol = matrix.metadata.ncol;
+    view.columns.resize(view.ncol);
+    for (int j = 0; j < view.ncol; j++) {
+        const SvtEntry &entry = matrix.svt[j];
+        SparseColumn &column = view.columns[j];
+        column.rows = entry[kSvtRowInd].data();
+        column.int_values = entry[kSvtValInd].data();
+        column.nnz = entry[kSvtRowInd].size();
+    }
+    return view;
+}
+
+// Views a CSC matrix given by its column offsets (size ncol + 1, int as in a
+// dgCMatrix or size_t), row indices and values. `values` is null for pattern
+// matrices.
+template <typename T, typename Offset>
+SparseColumns columnsFromCsc(int nrow, int ncol, const Offset *col_ptr,
+                             const int *row_ind, const T *values) {
+    SparseColumns view;
+    view.nrow = nrow;
+    view.ncol = ncol;
+    view.columns.resize(ncol);
+    for (int j = 0; j < ncol; j++) {
+        SparseColumn &column = view.columns[j];
+        column.rows = row_ind + col_ptr[j];
+        column.nnz = col_ptr[j + 1] - col_ptr[j];
+        if (values == nullptr) {
+            continue;
+        }
+        if constexpr (std::is_same_v<T, double>) {
+            column.real_values = values + col_ptr[j];
+        } else if constexpr (std::is_same_v<T, float>) {
+            column.float_values = values + col_ptr[j];
+        } else {
+            column.int_values = values + col_ptr[j];
+        }
+    }
+    return view;
+}
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_SPARSE_COLUMNS_H_
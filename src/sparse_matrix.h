@@ -5,9 +5,7 @@
 #include <string>
 #include <vector>
 
-#include "Rcpp.h"
-
-using namespace Rcpp;
+#include "name_table.h"
 
 namespace smallcount {
 
@@ -27,8 +25,8 @@ struct MatrixMetadata {
     int ncol;     // Number of columns
     size_t nval;  // Number of non-zero values
 
-    std::vector<std::string> row_names;  // Row names
-    std::vector<std::string> col_names;  // Column names
+    NameTable row_names;  // Row names
+    NameTable col_names;  // Column names
 };
 
 // SVT representation of a sparse matrix.
@@ -37,17 +35,14 @@ struct SvtSparseMatrix {
     SvtSparseMatrix(Svt svt, MatrixMetadata metadata)
         : svt(std::move(svt)), metadata(std::move(metadata)) {}
 
-    // Consumes the matrix and converts it to an S4 object.
-    SEXP toRcpp();
+    // Sorts the entries of each column by row index, as required by the SVT
+    // format.
+    void sortRowIndices();
 
-   private:
     // Sparse vector tree.
     Svt svt{};
     // Metadata for the number of rows, columns, and non-zero values.
     MatrixMetadata metadata;
-
-    // Converts the C++ SVT matrix to an Rcpp List.
-    static List createSvtList(Svt svt);
 };
 
 }  // namespace smallcount
@@ -0,0 +1,106 @@
+#include "sparse_sums.h"
+
+#include <vector>
+
+#include "csr_index.h"
+#include "profiler.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+std::vector<double> colSums(const SparseColumns &view) {
+    std::vector<double> sums(view.ncol, 0);
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int j = 0; j < view.ncol; j++) {
+        double sum = 0;
+        view.columns[j].forEach([&](int, double value) { sum += value; });
+        sums[j] = sum;
+    }
+    return sums;
+}
+
+std::vector<double> rowSums(const SparseColumns &view) {
+    std::vector<double> sums(view.nrow, 0);
+    for (const SparseColumn &column : view.columns) {
+        column.forEach([&](int row, double value) { sums[row] += value; });
+    }
+    return sums;
+}
+
+std::vector<double> rowTransformSums(const SparseColumns &view,
+                                     const Transformation &transform,
+                                     const double *rate, const double *n) {
+    ScopedStage stage("row_transform_sums");
+    stage.addNnz(view.nnz());
+    std::vector<double> sums(view.nrow, 0);
+    for (int j = 0; j < view.ncol; j++) {
+        view.columns[j].forEach([&](int row, double value) {
+            sums[row] += transform(value, rate[row] * n[j]);
+        });
+    }
+    return sums;
+}
+
+std::vector<double> groupRowSums(const SparseColumns &view, const int *groups,
+                                 int num_groups) {
+    ScopedStage stage("group_row_sums");
+    stage.addNnz(view.nnz());
+    std::vector<double> sums(static_cast<size_t>(view.nrow) * num_groups, 0);
+    for (int j = 0; j < view.ncol; j++) {
+        if (groups[j] < 0) {
+            continue;
+        }
+        double *group_sums = sums.data() + static_cast<size_t>(groups[j]) *
+                                               view.nrow;
+        view.columns[j].forEach(
+            [&](int row, double value) { group_sums[row] += value; });
+    }
+    return sums;
+}
+
+std::vector<double> rowSums(const CsrIndex &index) {
+    std::vector<double> sums(index.nrow, 0);
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < index.nrow; i++) {
+        double sum = 0;
+        index.forEachInRow(i, [&](int, double value) { sum += value; });
+        sums[i] = sum;
+    }
+    return sums;
+}
+
+std::vector<double> rowTransformSums(const CsrIndex &index,
+                                     const Transformation &transform,
+                                     const double *rate, const double *n) {
+    ScopedStage stage("row_transform_sums");
+    stage.addNnz(index.nnz());
+    std::vector<double> sums(index.nrow, 0);
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < index.nrow; i++) {
+        double sum = 0;
+        index.forEachInRow(i, [&](int col, double value) {
+            sum += transform(value, rate[i] * n[col]);
+        });
+        sums[i] = sum;
+    }
+    return sums;
+}
+
+std::vector<double> groupRowSums(const CsrIndex &index, const int *groups,
+                                 int num_groups) {
+    ScopedStage stage("group_row_sums");
+    stage.addNnz(index.nnz());
+    std::vector<double> sums(static_cast<size_t>(index.nrow) * num_groups, 0);
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < index.nrow; i++) {
+        index.forEachInRow(i, [&](int col, double value) {
+            if (groups[col] >= 0) {
+                sums[i + static_cast<size_t>(groups[col]) * index.nrow] +=
+                    value;
+            }
+        });
+    }
+    return sums;
+}
+
+}  // namespace smallcount
@@ -0,0 +1,44 @@
+#ifndef SMALLCOUNT_SPARSE_SUMS_H_
+#define SMALLCOUNT_SPARSE_SUMS_H_
+
+#include <functional>
+#include <vector>
+
+#include "csr_index.h"
+#include "sparse_columns.h"
+
+namespace smallcount {
+
+// Function `f(y, mu)` of a non-zero count `y` with expected value `mu`.
+using Transformation = std::function<double(double, double)>;
+
+// Sum of each column.
+std::vector<double> colSums(const SparseColumns &view);
+
+// Sum of each row.
+std::vector<double> rowSums(const SparseColumns &view);
+
+// Sum of `transform(y, rate[i] * n[j])` over the non-zero entries y of each row
+// i, where j is the column of y.
+std::vector<double> rowTransformSums(const SparseColumns &view,
+                                     const Transformation &transform,
+                                     const double *rate, const double *n);
+
+// Row sums of the columns in each of `num_groups` groups (nrow x num_groups,
+// column-major). `groups` holds the 0-based group of each column; columns
+// with a negative group are skipped.
+std::vector<double> groupRowSums(const SparseColumns &view, const int *groups,
+                                 int num_groups);
+
+// Row-wise versions of the sums above, which read each row of a CsrIndex
+// sequentially and run in parallel over rows.
+std::vector<double> rowSums(const CsrIndex &index);
+std::vector<double> rowTransformSums(const CsrIndex &index,
+                                     const Transformation &transform,
+                                     const double *rate, const double *n);
+std::vector<double> groupRowSums(const CsrIndex &index, const int *groups,
+                                 int num_groups);
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_SPARSE_SUMS_H_
@@ -0,0 +1,226 @@
+#include "tar_reader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "error.h"
+
+namespace smallcount {
+namespace {
+
+// Size of the header and data blocks of a tar archive.
+static constexpr size_t kBlockSize = 512;
+// Bytes of file contents read from the source at once.
+static constexpr size_t kBufferSize = 1 << 16;
+
+// Header fields (offset and size in bytes).
+static constexpr size_t kNameOffset = 0;
+static constexpr size_t kNameSize = 100;
+static constexpr size_t kSizeOffset = 124;
+static constexpr size_t kSizeSize = 12;
+static constexpr size_t kTypeOffset = 156;
+static constexpr size_t kMagicOffset = 257;
+static constexpr size_t kPrefixOffset = 345;
+static constexpr size_t kPrefixSize = 155;
+
+// Magic of POSIX (ustar) headers, which split long paths into a prefix and
+// a name. GNU headers ("ustar  ") store other fields in place of the prefix.
+static constexpr char kUstarMagic[] = "ustar";
+
+// Types of archive entries.
+static constexpr char kRegularFile = '0';
+static constexpr char kOldRegularFile = '\0';
+static constexpr char kContiguousFile = '7';
+static constexpr char kGnuLongName = 'L';
+static constexpr char kPaxHeader = 'x';
+
+// Returns a null-terminated (or full-width) string field of a header.
+std::string headerString(const char *header, size_t offset, size_t size) {
+    return std::string(header + offset, strnlen(header + offset, size));
+}
+
+// Parses the size field of a header, in octal or (for files of 8 GB or more)
+// in the big-endian base-256 extension of GNU tar.
+size_t parseSize(const char *header) {
+    const unsigned char *field =
+        reinterpret_cast<const unsigned char *>(header + kSizeOffset);
+    size_t size = 0;
+    if (field[0] & 0x80) {
+        for (size_t i = 1; i < kSizeSize; i++) {
+            size = (size << 8) | field[i];
+        }
+        return size;
+    }
+    size_t i = 0;
+    while (i < kSizeSize && field[i] == ' ') {
+        i++;
+    }
+    for (; i < kSizeSize && field[i] >= '0' && field[i] <= '7'; i++) {
+        size = size * 8 + (field[i] - '0');
+    }
+    return size;
+}
+
+// Whether a header block is all zeros, which marks the end of the archive.
+bool isZeroBlock(const char *header) {
+    return std::all_of(header, header + kBlockSize,
+                       [](char c) { return c == '\0'; });
+}
+
+// Path and size of the next member, from a pax extended header.
+struct PaxHeader {
+    std::string path;
+    bool has_size = false;
+    size_t size = 0;
+};
+
+// Reads the path and size from the records ("<length> <key>=<value>\n") of a
+// pax extended header.
+void parsePaxRecords(const std::string &records, PaxHeader *pax) {
+    size_t pos = 0;
+    while (pos < records.size()) {
+        const size_t space = records.find(' ', pos);
+        if (space == std::string::npos) {
+            break;
+        }
+        const size_t length = std::strtoull(records.c_str() + pos, nullptr, 10);
+        if (length == 0 || pos + length > records.size()) {
+            break;
+        }
+        const std::string record =
+            records.substr(space + 1, pos + length - space - 2);
+        const size_t equals = record.find('=');
+        if (equals != std::string::npos) {
+            const std::string key = record.substr(0, equals);
+            const std::string value = record.substr(equals + 1);
+            if (key == "path") {
+                pax->path = value;
+            } else if (key == "size") {
+                pax->has_size = true;
+                pax->size = std::strtoull(value.c_str(), nullptr, 10);
+            }
+        }
+        pos += length;
+    }
+}
+
+// Skips `count` bytes of a stream buffer.
+void skipBytes(std::streambuf *source, size_t count) {
+    char buffer[kBlockSize];
+    while (count > 0) {
+        const size_t size = std::min(count, kBlockSize);
+        if (static_cast<size_t>(source->sgetn(buffer, size)) != size) {
+            fail("Truncated tar archive.");
+        }
+        count -= size;
+    }
+}
+
+}  // namespace
+
+TarReader::MemberStreamBuf::MemberStreamBuf(std::streambuf *source)
+    : source(source), buffer(kBufferSize) {
+    reset(0);
+}
+
+void TarReader::MemberStreamBuf::reset(size_t size) {
+    member_size = size;
+    remaining = size;
+    setg(buffer.data(), buffer.data(), buffer.data());
+}
+
+void TarReader::MemberStreamBuf::skipRest() {
+    skipBytes(source, remaining);
+    reset(0);
+}
+
+TarReader::MemberStreamBuf::int_type TarReader::MemberStreamBuf::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    if (remaining == 0) {
+        return traits_type::eof();
+    }
+    const size_t size = std::min(remaining, buffer.size());
+    if (static_cast<size_t>(source->sgetn(buffer.data(), size)) != size) {
+        fail("Truncated tar archive.");
+    }
+    remaining -= size;
+    setg(buffer.data(), buffer.data(), buffer.data() + size);
+    return traits_type::to_int_type(*gptr());
+}
+
+TarReader::TarReader(std::streambuf *source)
+    : source(source), member(source), member_stream(&member) {
+    // Let errors of the source (e.g., invalid compressed data) propagate
+    // instead of ending the stream.
+    member_stream.exceptions(std::ios::badbit);
+}
+
+std::string TarReader::readContents() {
+    std::string contents(member.size(), '\0');
+    member_stream.read(contents.data(), contents.size());
+    return contents;
+}
+
+bool TarReader::next() {
+    std::string long_name;
+    PaxHeader pax;
+    char header[kBlockSize];
+    while (true) {
+        member.skipRest();
+        skipBytes(source, padding);
+        padding = 0;
+        member_stream.clear();
+
+        const size_t bytes = source->sgetn(header, kBlockSize);
+        if (bytes == 0 || (bytes == kBlockSize && isZeroBlock(header))) {
+            return false;
+        } else if (bytes != kBlockSize) {
+            fail("Truncated tar archive.");
+        }
+        const char type = header[kTypeOffset];
+        size_t size = parseSize(header);
+        if ((type == kRegularFile || type == kOldRegularFile ||
+             type == kContiguousFile) &&
+            pax.has_size) {
+            size = pax.size;
+        }
+        member.reset(size);
+        padding = (kBlockSize - size % kBlockSize) % kBlockSize;
+
+        if (type == kGnuLongName) {
+            const std::string contents = readContents();
+            long_name = contents.substr(0, strnlen(contents.data(), size));
+        } else if (type == kPaxHeader) {
+            parsePaxRecords(readContents(), &pax);
+        } else if (type == kRegularFile || type == kOldRegularFile ||
+                   type == kContiguousFile) {
+            if (!long_name.empty()) {
+                member_path = long_name;
+            } else if (!pax.path.empty()) {
+                member_path = pax.path;
+            } else {
+                const bool ustar = memcmp(header + kMagicOffset, kUstarMagic,
+                                          sizeof(kUstarMagic)) == 0;
+                const std::string prefix =
+                    ustar ? headerString(header, kPrefixOffset, kPrefixSize)
+                          : "";
+                const std::string name =
+                    headerString(header, kNameOffset, kNameSize);
+                member_path = prefix.empty() ? name : prefix + "/" + name;
+            }
+            return true;
+        } else {
+            // Directories, links and global headers have no file to read.
+            long_name.clear();
+            pax = PaxHeader();
+        }
+    }
+}
+
+}  // namespace smallcount
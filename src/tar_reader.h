@@ -0,0 +1,67 @@
+#ifndef SMALLCOUNT_TAR_READER_H_
+#define SMALLCOUNT_TAR_READER_H_
+
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace smallcount {
+
+// Sequential reader of the regular files of a tar archive (ustar, GNU or pax
+// format), read from a stream buffer such as a DecompressingStreamBuf. The
+// contents of each file are streamed from the archive, so that no file is
+// extracted to disk.
+class TarReader {
+   public:
+    // Reads from `source`, which must outlive the reader.
+    explicit TarReader(std::streambuf *source);
+    TarReader(const TarReader &) = delete;
+    TarReader &operator=(const TarReader &) = delete;
+
+    // Advances to the next regular file, skipping the unread contents of the
+    // current one. Returns false at the end of the archive.
+    bool next();
+
+    // Path of the current file within the archive.
+    const std::string &path() const { return member_path; }
+    // Size of the current file in bytes.
+    size_t size() const { return member.size(); }
+    // Stream of the contents of the current file, valid until next().
+    std::istream &contents() { return member_stream; }
+
+   private:
+    // Stream buffer limited to the contents of the current file.
+    class MemberStreamBuf : public std::streambuf {
+       public:
+        explicit MemberStreamBuf(std::streambuf *source);
+        // Starts a file of `size` bytes.
+        void reset(size_t size);
+        // Skips the unread bytes of the file.
+        void skipRest();
+        size_t size() const { return member_size; }
+
+       protected:
+        int_type underflow() override;
+
+       private:
+        std::streambuf *source;
+        std::vector<char> buffer;
+        size_t member_size = 0;
+        size_t remaining = 0;  // Bytes of the file not yet buffered
+    };
+
+    // Reads the contents of the current file (e.g., a long name).
+    std::string readContents();
+
+    std::streambuf *source;
+    MemberStreamBuf member;
+    std::istream member_stream;
+    std::string member_path;
+    // Padding of the current file to a multiple of the block size.
+    size_t padding = 0;
+};
+
+}  // namespace smallcount
+
+#endif  // SMALLCOUNT_TAR_READER_H_
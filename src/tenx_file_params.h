@@ -21,6 +21,12 @@ struct TenxFileParams {
     // FOR HDF5 FILES:
     // Name of the HDF5 group containing the matrix datasets for CellRanger v2.
     std::optional<std::string> genome = std::nullopt;
+
+    // FOR QC METRICS:
+    // Whether to accumulate per-row and per-column QC metrics while parsing.
+    bool compute_qc = false;
+    // Regular expression identifying mitochondrial features by name.
+    std::string mito_pattern;
 };
 
 }  // namespace smallcount
@@ -11,6 +11,7 @@ Output file formats:
     2. .mtx, tarballed and bzipped
     3. .h5, using CellRanger v3 format
     4. .h5, using CellRanger v2 format
+    5. .h5, using CellRanger v3 format with variable-length strings
 """
 
 import h5py
@@ -104,3 +105,14 @@ hf2.create_dataset("genome/shape", dtype=np.uint64, data=csc_mat.shape)
 hf2.create_dataset("genome/gene_names", data=utf8_rows)
 hf2.create_dataset("genome/barcodes", data=utf8_cols)
 hf2.close()
+
+# .h5 file (Cell Ranger v3, variable-length strings)
+hf3 = h5py.File(filedir + filename + "_v3_vlen.h5", "w")
+hf3.create_dataset("matrix/data", dtype=np.uint32, data=csc_mat.data)
+hf3.create_dataset("matrix/indices", dtype=np.uint32, data=csc_mat.indices)
+hf3.create_dataset("matrix/indptr", dtype=np.uint32, data=csc_mat.indptr)
+hf3.create_dataset("matrix/shape", dtype=np.uint64, data=csc_mat.shape)
+vlen_str = h5py.string_dtype(encoding="utf-8")
+hf3.create_dataset("matrix/features/id", data=rows, dtype=vlen_str)
+hf3.create_dataset("matrix/barcodes", data=cols, dtype=vlen_str)
+hf3.close()